@@ -0,0 +1,358 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+// Microbenchmarks of the intersection, traversal, BVH build, shading and
+// image output kernels. Inputs come from a fixed seed, results go out as JSON.
+//
+// PlusProtoBench [--obj file.obj]... [--out results.json] [--repeats N] [--quick]
+#include "Global.hpp"
+#include "AABB.hpp"
+#include "Model.hpp"
+#include "BVH.hpp"
+#include "Material.hpp"
+#include "Buffer.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#ifdef _MSC_VER
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define fdopen _fdopen
+#else
+#include <unistd.h>
+#endif
+
+#ifndef PLUSPROTO_VERSION
+#define PLUSPROTO_VERSION "unknown"
+#endif
+
+class BenchResult
+{
+public:
+	std::string _name;
+	std::string _unit;
+	double _value;
+	long long _iterations;
+};
+
+class BenchSuite
+{
+public:
+	std::vector<BenchResult> _results;
+	int _repeats = 5;
+	std::mt19937 _rng{ 20261019u };
+	volatile double _sink = 0;	// keeps the measured work alive
+
+	flt uniform(flt lo = 0, flt hi = 1)
+	{
+		return std::uniform_real_distribution<flt>(lo, hi)(_rng);
+	}
+	glm::vec3 point(const AABB& box)
+	{
+		glm::vec3 lo = box.getMin(), hi = box.getMax();
+		return glm::vec3(uniform(lo.x, hi.x), uniform(lo.y, hi.y), uniform(lo.z, hi.z));
+	}
+	glm::vec3 direction()
+	{
+		flt z = uniform(-1, 1), a = uniform(0, 2 * pi);
+		flt r = sqrtf(1 - z * z);
+		return glm::vec3(r * cosf(a), r * sinf(a), z);
+	}
+
+	// median wall time of _repeats runs, in seconds
+	template <class F>
+	double time(F f)
+	{
+		std::vector<double> runs;
+		for (int i = 0; i < _repeats; i++) {
+			double start = omp_get_wtime();
+			f();
+			runs.push_back(omp_get_wtime() - start);
+		}
+		std::sort(runs.begin(), runs.end());
+		return runs[runs.size() / 2];
+	}
+
+	void add(const std::string& name, const std::string& unit, double value, long long iterations)
+	{
+		_results.push_back(BenchResult{ name, unit, value, iterations });
+		// progress goes to stderr, stdout may carry the JSON
+		fprintf(stderr, "%-44s %12.3f %s\n", name.c_str(), value, unit.c_str());
+	}
+
+	static std::string escape(const std::string& s)
+	{
+		std::string res;
+		for (char c : s) {
+			if (c == '"' || c == '\\')
+				res += '\\';
+			res += c;
+		}
+		return res;
+	}
+
+	void writeJson(std::ostream& out) const
+	{
+		out << "{\n  \"version\": \"" << PLUSPROTO_VERSION << "\",\n";
+		out << "  \"threads\": " << omp_get_max_threads() << ",\n";
+		out << "  \"repeats\": " << _repeats << ",\n  \"results\": [\n";
+		for (size_t i = 0; i < _results.size(); i++) {
+			const BenchResult& r = _results[i];
+			char value[64];
+			snprintf(value, sizeof(value), "%.6g", r._value);
+			out << "    { \"name\": \"" << escape(r._name) << "\", \"unit\": \"" << r._unit
+				<< "\", \"value\": " << value << ", \"iterations\": " << r._iterations << " }"
+				<< (i + 1 < _results.size() ? ",\n" : "\n");
+		}
+		out << "  ]\n}\n";
+	}
+};
+
+static std::vector<Triangle*> generateSoup(BenchSuite& suite, int count)
+{
+	std::vector<Triangle*> triangles;
+	AABB unit(glm::vec3(0), glm::vec3(1));
+	for (int i = 0; i < count; i++) {
+		glm::vec3 p = suite.point(unit);
+		glm::vec3 v1 = p + suite.direction() * 0.01f;
+		glm::vec3 v2 = p + suite.direction() * 0.01f;
+		glm::vec3 v3 = p + suite.direction() * 0.01f;
+		triangles.push_back(new Triangle(v1, v2, v3));
+	}
+	return triangles;
+}
+
+static std::vector<Triangle*> loadObj(const std::string& path)
+{
+	tinyobj::ObjReader reader;
+	if (!reader.ParseFromFile(path)) {
+		ERRORM("Cannot read %s: %s\n", path.c_str(), reader.Error().c_str());
+	}
+	const tinyobj::attrib_t& attrib = reader.GetAttrib();
+	std::vector<Triangle*> triangles;
+	for (const tinyobj::shape_t& shape : reader.GetShapes()) {
+		const std::vector<tinyobj::index_t>& indices = shape.mesh.indices;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			glm::vec3 v[3];
+			for (int k = 0; k < 3; k++) {
+				int idx = indices[i + k].vertex_index;
+				v[k] = glm::vec3(attrib.vertices[3 * idx], attrib.vertices[3 * idx + 1], attrib.vertices[3 * idx + 2]);
+			}
+			triangles.push_back(new Triangle(v[0], v[1], v[2]));
+		}
+	}
+	return triangles;
+}
+
+static void benchPrimitives(BenchSuite& suite, int num_rays)
+{
+	AABB box(glm::vec3(-1), glm::vec3(1));
+	AABB spawn(glm::vec3(-4), glm::vec3(4));
+	std::vector<Ray> rays;
+	for (int i = 0; i < num_rays; i++) {
+		glm::vec3 o = suite.point(spawn);
+		rays.push_back(Ray(o, suite.point(box) - o));
+	}
+
+	double seconds = suite.time([&]() {
+		int hits = 0;
+		flt t;
+		for (const Ray& r : rays)
+			hits += box.hit(r, kHitEps, INFINITY, t);
+		suite._sink = suite._sink + hits;
+	});
+	suite.add("aabb_hit", "ns/ray", seconds / num_rays * 1e9, num_rays);
+
+	std::vector<Triangle*> triangles;
+	for (int i = 0; i < 1024; i++) {
+		glm::vec3 v1 = suite.point(box), v2 = suite.point(box), v3 = suite.point(box);
+		triangles.push_back(new Triangle(v1, v2, v3));
+	}
+	seconds = suite.time([&]() {
+		int hits = 0;
+		HitRecord rec;
+		for (int i = 0; i < num_rays; i++)
+			hits += triangles[i & 1023]->hit(rays[i], kHitEps, INFINITY, rec);
+		suite._sink = suite._sink + hits;
+	});
+	suite.add("triangle_hit", "ns/ray", seconds / num_rays * 1e9, num_rays);
+	for (Triangle* tri : triangles)
+		delete tri;
+}
+
+static void benchScene(BenchSuite& suite, const std::string& scene, std::vector<Triangle*>& triangles, int num_rays)
+{
+	std::vector<Hittable*> objects(triangles.begin(), triangles.end());
+	const char* builders[] = { "midpoint", "sbvh", "lbvh" };
+
+	for (const char* builder : builders) {
+		Bvh bvh;
+		bvh.setBuilder(Bvh::builderFromName(builder), 0.5f, omp_get_max_threads());
+		double seconds = suite.time([&]() { bvh.buildTree(objects); });
+		std::string prefix = std::string("bvh_") + builder + "/" + scene;
+		suite.add(prefix + "/build", "s/Mtri", seconds / objects.size() * 1e6, objects.size());
+
+		AABB bounds = bvh.getBounds();
+		glm::vec3 center = bounds.center();
+		flt radius = glm::length(bounds.getMax() - bounds.getMin());
+		std::vector<Ray> random_rays, coherent_rays, shadow_rays;
+		std::vector<flt> shadow_tmax;
+		for (int i = 0; i < num_rays; i++)
+			random_rays.push_back(Ray(suite.point(bounds), suite.direction()));
+		int side = int(sqrtf(flt(num_rays)));
+		glm::vec3 eye = center + glm::vec3(0.3f, 0.2f, 1.0f) * radius;
+		for (int y = 0; y < side; y++)
+			for (int x = 0; x < side; x++) {
+				glm::vec3 target = center + (glm::vec3(flt(x) / side, flt(y) / side, 0.5f) - 0.5f) * radius * 0.5f;
+				coherent_rays.push_back(Ray(eye, target - eye));
+			}
+		for (int i = 0; i < num_rays; i++) {
+			glm::vec3 from = suite.point(bounds), to = suite.point(bounds);
+			shadow_rays.push_back(Ray(from, to - from));
+			shadow_tmax.push_back(glm::length(to - from));
+		}
+
+		auto trace = [&](const std::vector<Ray>& rays, const std::vector<flt>* tmax) {
+			return suite.time([&]() {
+				int hits = 0;
+				HitRecord rec;
+				for (size_t i = 0; i < rays.size(); i++)
+					hits += bvh.hit(rays[i], kHitEps, tmax ? (*tmax)[i] : INFINITY, rec);
+				suite._sink = suite._sink + hits;
+			});
+		};
+		suite.add(prefix + "/random", "Mrays/s", random_rays.size() / trace(random_rays, NULL) * 1e-6, random_rays.size());
+		suite.add(prefix + "/coherent", "Mrays/s", coherent_rays.size() / trace(coherent_rays, NULL) * 1e-6, coherent_rays.size());
+		suite.add(prefix + "/shadow", "Mrays/s", shadow_rays.size() / trace(shadow_rays, &shadow_tmax) * 1e-6, shadow_rays.size());
+	}
+}
+
+static void benchShading(BenchSuite& suite, int count)
+{
+	Material mat{};
+	mat._type = DIFFUSE;
+	mat._kd = glm::vec3(0.6f, 0.5f, 0.4f);
+	mat._ks = glm::vec3(0.2f);
+	mat._ns = 32;
+	mat.prepare();
+
+	std::vector<HitRecord> recs(count);
+	std::vector<Ray> rays(count);
+	for (int i = 0; i < count; i++) {
+		recs[i]._mat = &mat;
+		recs[i]._pos = glm::vec3(0);
+		recs[i]._normal = glm::vec3(0, 0, 1);
+		glm::vec3 d = suite.direction();
+		rays[i] = Ray(glm::vec3(d.x, d.y, fabsf(d.z)), glm::vec3(-d.x, -d.y, -fabsf(d.z)));
+	}
+	std::vector<glm::vec3> wi(count);
+
+	double seconds = suite.time([&]() {
+		double sum = 0;
+		Ray scattered;
+		for (int i = 0; i < count; i++) {
+			sum += mat.scatter(rays[i], recs[i], scattered);
+			wi[i] = scattered.getDirection();
+		}
+		suite._sink = suite._sink + sum;
+	});
+	suite.add("material_scatter", "ns/op", seconds / count * 1e9, count);
+
+	seconds = suite.time([&]() {
+		double sum = 0;
+		for (int i = 0; i < count; i++)
+			sum += mat.bsdf(wi[i], recs[i], -rays[i].getDirection()).x;
+		suite._sink = suite._sink + sum;
+	});
+	suite.add("material_bsdf", "ns/op", seconds / count * 1e9, count);
+
+	seconds = suite.time([&]() {
+		double sum = 0;
+		ShadingBatch batch;
+		for (int i = 0; i < count; i++) {
+			batch.add(wi[i], recs[i], -rays[i].getDirection());
+			if (batch.full() || i + 1 == count) {
+				batch.eval();
+				sum += batch._f[0][0];
+				batch.clear();
+			}
+		}
+		suite._sink = suite._sink + sum;
+	});
+	suite.add("shading_batch_eval", "ns/op", seconds / count * 1e9, count);
+}
+
+static void benchOutput(BenchSuite& suite, int size)
+{
+	Buffer buf(size, size);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+			buf.setColor(x, y, glm::vec3(suite.uniform(), suite.uniform(), suite.uniform()));
+	const char* path = "bench_render_to_pic.jpg";
+	double seconds = suite.time([&]() { buf.renderToPic(path, 2.2f, 1); });
+	std::remove(path);
+	suite.add("buffer_render_to_pic", "ms/Mpixel", seconds / (double(size) * size) * 1e9, 1LL * size * size);
+}
+
+int main(int argc, char** argv)
+{
+	BenchSuite suite;
+	std::vector<std::string> objs;
+	std::string out_path;
+	bool quick = false;
+	for (int i = 1; i < argc; i++) {
+		std::string key = argv[i];
+		if (key == "--quick")
+			quick = true;
+		else if (i + 1 < argc && key == "--obj")
+			objs.push_back(argv[++i]);
+		else if (i + 1 < argc && key == "--out")
+			out_path = argv[++i];
+		else if (i + 1 < argc && key == "--repeats")
+			suite._repeats = std::max(1, std::stoi(argv[++i]));
+		else
+			ERRORM("Usage: %s [--obj file.obj]... [--out results.json] [--repeats N] [--quick]\n", argv[0]);
+	}
+	// without --out the JSON owns stdout, so the messages of the engine
+	// (INFO prints to stdout) are moved to stderr with the progress lines
+	FILE* json = stdout;
+	if (out_path.empty()) {
+		fflush(stdout);
+		json = fdopen(dup(fileno(stdout)), "w");
+		dup2(fileno(stderr), fileno(stdout));
+	}
+	int scale = quick ? 10 : 1;
+	random_seed(1);
+
+	benchPrimitives(suite, 1000000 / scale);
+
+	std::vector<Triangle*> soup = generateSoup(suite, 200000 / scale);
+	benchScene(suite, "soup", soup, 250000 / scale);
+	for (Triangle* tri : soup)
+		delete tri;
+	for (const std::string& obj : objs) {
+		std::vector<Triangle*> triangles = loadObj(obj);
+		if (triangles.empty())
+			continue;
+		std::string name = obj.substr(obj.find_last_of("/\\") + 1);
+		benchScene(suite, name, triangles, 250000 / scale);
+		for (Triangle* tri : triangles)
+			delete tri;
+	}
+
+	benchShading(suite, 1000000 / scale);
+	benchOutput(suite, quick ? 256 : 1024);
+
+	if (out_path.empty()) {
+		std::ostringstream out;
+		suite.writeJson(out);
+		fputs(out.str().c_str(), json);
+		fclose(json);
+	}
+	else {
+		std::ofstream out(out_path);
+		suite.writeJson(out);
+		INFO("Results written to %s\n", out_path.c_str());
+	}
+	return 0;
+}
@@ -11,6 +11,7 @@ private:
 public:
 	AABB() {}
 	AABB(const glm::vec3& v);
+	AABB(const glm::vec3& lo, const glm::vec3& hi) : _min(lo), _max(hi) {}
 	void init();
 	
 	bool hit(const Ray& r, flt tmin, flt tmax, flt& thit) const;
@@ -20,12 +21,15 @@ public:
 
 	inline glm::vec3 center() const { return (_min + _max) * flt(0.5); }
 	inline flt volume() const { return width() * height() * depth(); }
+	inline flt area() const { return 2 * (width() * height() + height() * depth() + depth() * width()); }
 	inline flt width()  const { return _max[0] - _min[0]; }
 	inline flt height() const { return _max[1] - _min[1]; }
 	inline flt depth()  const { return _max[2] - _min[2]; }
 
 	inline glm::vec3 getMax() const { return _max; }
 	inline glm::vec3 getMin() const { return _min; }
+	inline bool empty() const { return _min.x > _max.x || _min.y > _max.y || _min.z > _max.z; }
+	inline AABB intersection(const AABB& b) const { return AABB(glm::max(_min, b._min), glm::min(_max, b._max)); }
 
 	AABB& operator += (const glm::vec3& p)
 	{
@@ -0,0 +1,103 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include <algorithm>
+#include "Animation.hpp"
+
+static void readVec3Attribute(const tinyxml2::XMLElement* element, const char* name, glm::vec3& v)
+{
+    auto str = element->Attribute(name);
+    if (str && sscanf_s(str, "%f,%f,%f", &v[0], &v[1], &v[2]) != 3) {
+        ERRORM("cannot read 3 floats in %s attribute\n", name);
+    }
+}
+
+void TransformKey::initFromXML(const tinyxml2::XMLElement* element)
+{
+    element->QueryIntAttribute("frame", &_frame);
+    readVec3Attribute(element, "translate", _translate);
+    readVec3Attribute(element, "rotate", _rotate);
+    readVec3Attribute(element, "scale", _scale);
+}
+
+glm::mat4 TransformKey::matrix() const
+{
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), _translate);
+    m = glm::rotate(m, glm::radians(_rotate[2]), glm::vec3(0, 0, 1));
+    m = glm::rotate(m, glm::radians(_rotate[1]), glm::vec3(0, 1, 0));
+    m = glm::rotate(m, glm::radians(_rotate[0]), glm::vec3(1, 0, 0));
+    return glm::scale(m, _scale);
+}
+
+glm::mat4 TransformTrack::at(int frame) const
+{
+    if (frame <= _keys.front()._frame)
+        return _keys.front().matrix();
+    if (frame >= _keys.back()._frame)
+        return _keys.back().matrix();
+
+    size_t k = 1;
+    while (_keys[k]._frame < frame)
+        k++;
+    const TransformKey& a = _keys[k - 1];
+    const TransformKey& b = _keys[k];
+    flt f = flt(frame - a._frame) / flt(b._frame - a._frame);
+
+    TransformKey key;
+    key._translate = glm::mix(a._translate, b._translate, f);
+    key._rotate = glm::mix(a._rotate, b._rotate, f);
+    key._scale = glm::mix(a._scale, b._scale, f);
+    return key.matrix();
+}
+
+void Animation::initFromXML(const tinyxml2::XMLDocument& xmlconfig,
+    const glm::vec3& eye, const glm::vec3& lookat, const glm::vec3& up)
+{
+    auto animNode = xmlconfig.FirstChildElement("animation");
+    if (!animNode)
+        return;
+
+    animNode->QueryIntAttribute("frames", &_frames);
+    auto vertices = animNode->Attribute("vertices");
+    if (vertices)
+        _vertices = vertices;
+
+    // the camera of the scene is the key at frame 0
+    CameraKey base;
+    base._eye = eye;
+    base._lookat = lookat;
+    base._up = up;
+    _camera_keys.push_back(base);
+
+    auto keyNode = animNode->FirstChildElement("camera");
+    while (keyNode) {
+        CameraKey key = _camera_keys.back();
+        keyNode->QueryIntAttribute("frame", &key._frame);
+        readVec3Attribute(keyNode, "eye", key._eye);
+        readVec3Attribute(keyNode, "lookat", key._lookat);
+        readVec3Attribute(keyNode, "up", key._up);
+        _camera_keys.push_back(key);
+        keyNode = keyNode->NextSiblingElement("camera");
+    }
+    std::stable_sort(_camera_keys.begin(), _camera_keys.end(),
+        [](const CameraKey& a, const CameraKey& b) { return a._frame < b._frame; });
+    INFO("Animation: %d frames, %d camera keys\n", _frames, int(_camera_keys.size()));
+}
+
+void Animation::cameraAt(int frame, glm::vec3& eye, glm::vec3& lookat, glm::vec3& up) const
+{
+    size_t k = 0;
+    while (k + 1 < _camera_keys.size() && _camera_keys[k + 1]._frame <= frame)
+        k++;
+    const CameraKey& a = _camera_keys[k];
+    if (k + 1 == _camera_keys.size() || frame <= a._frame) {
+        eye = a._eye;
+        lookat = a._lookat;
+        up = a._up;
+        return;
+    }
+    const CameraKey& b = _camera_keys[k + 1];
+    flt f = flt(frame - a._frame) / flt(b._frame - a._frame);
+    eye = glm::mix(a._eye, b._eye, f);
+    lookat = glm::mix(a._lookat, b._lookat, f);
+    up = glm::normalize(glm::mix(a._up, b._up, f));
+}
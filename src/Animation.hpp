@@ -0,0 +1,63 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Model.hpp"
+#include "Instance.hpp"
+
+// translate, rotate (degrees around x, then y, then z) and scale at one frame
+class TransformKey
+{
+public:
+	int _frame = 0;
+	glm::vec3 _translate = glm::vec3(0.0f);
+	glm::vec3 _rotate = glm::vec3(0.0f);
+	glm::vec3 _scale = glm::vec3(1.0f);
+
+	void initFromXML(const tinyxml2::XMLElement* element);
+	glm::mat4 matrix() const;
+};
+
+// Keys sorted by frame, linearly interpolated in between.
+class TransformTrack
+{
+public:
+	std::vector<TransformKey> _keys;
+
+	glm::mat4 at(int frame) const;
+};
+
+class CameraKey
+{
+public:
+	int _frame = 0;
+	glm::vec3 _eye, _lookat, _up;
+};
+
+class AnimatedInstance
+{
+public:
+	Instance* _instance;
+	TransformTrack _track;
+	std::vector<Triangle*> _lights;	// world copies of Mesh::_lights, same order
+};
+
+// <animation frames="120" vertices="walk_">
+//     <camera frame="60" eye="x,y,z" lookat="x,y,z" up="x,y,z"/>
+// </animation>
+// vertices (optional) names per-frame OBJ files <vertices><frame>.obj holding the
+// vertex positions of the scene OBJ, same faces in the same order.
+// Instances are animated by <key frame=".." translate=".." .../> children.
+class Animation
+{
+public:
+	int _frames = 0;
+	std::string _vertices;
+	std::vector<CameraKey> _camera_keys;
+	std::vector<AnimatedInstance> _instances;
+
+	void initFromXML(const tinyxml2::XMLDocument& xmlconfig, const glm::vec3& eye, const glm::vec3& lookat, const glm::vec3& up);
+	void cameraAt(int frame, glm::vec3& eye, glm::vec3& lookat, glm::vec3& up) const;
+
+	inline bool enabled() const { return _frames > 0; }
+};
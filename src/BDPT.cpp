@@ -0,0 +1,265 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "BDPT.hpp"
+#include "Scene.hpp"
+
+namespace {
+
+const int kMaxVertices = 64;
+
+inline flt remap0(flt f)
+{
+	return f != 0 ? f : 1;
+}
+
+// solid angle density at from toward to, converted to a density per unit area at to
+inline flt toArea(flt pdf_dir, const PathVertex& from, const PathVertex& to)
+{
+	glm::vec3 d = to.pos() - from.pos();
+	flt dist2 = glm::dot(d, d);
+	if (dist2 <= 0)
+		return 0;
+	return pdf_dir * fabsf(glm::dot(to._rec._normal, d)) / (dist2 * sqrtf(dist2));
+}
+
+// density of v sampling next, v having been reached from prev. Emitters
+// without a prev sample their cosine weighted emission lobe.
+flt pdfArea(const PathVertex& v, const PathVertex* prev, const PathVertex& next)
+{
+	glm::vec3 wn = glm::normalize(next.pos() - v.pos());
+	flt pdf_dir;
+	if (!prev)
+		pdf_dir = glm::max(0.0f, glm::dot(v._rec._normal, wn)) / pi;
+	else
+		pdf_dir = v._rec._mat->pdf(wn, v._rec, glm::normalize(prev->pos() - v.pos()));
+	return toArea(pdf_dir, v, next);
+}
+
+}
+
+// Extends path[0] until max_vertices, a miss, an emitter or an absorbed sample.
+// Light subpaths cross glass like photons do. escaped receives what the
+// environment adds when the walk leaves the scene.
+int BidirectionalRender::randomWalk(Scene& scene, Ray ray, glm::vec3 beta, flt pdf_dir, PathVertex* path, int max_vertices, bool from_light,
+	glm::vec3* escaped)
+{
+	int n = 1;
+	while (n < max_vertices) {
+		PathVertex& prev = path[n - 1];
+		PathVertex& v = path[n];
+		v = PathVertex();
+		STAT_INC(STAT_BOUNCE_RAYS);
+		if (!scene.bvh_tree.hit(ray, kHitEps, INFINITY, v._rec)) {
+			if (escaped && scene.environment.enabled())
+				*escaped = beta * scene.environment.Le(ray.getDirection());
+			break;
+		}
+		if (!v._rec._mat)
+			v._rec._mat = &scene.default_mat;
+		const Material* mat = v._rec._mat;
+		glm::vec3 wo = -ray.getDirection();
+		v._beta = beta;
+		v._pdf_fwd = toArea(pdf_dir, prev, v);
+		n++;
+
+		if (mat->_type == LIGHT) {
+			// seen from the front an emitter ends a camera subpath, the light subpath could have started here
+			v._light = glm::dot(v._rec._normal, wo) > 0;
+			v._pdf_rev = 1 / scene.egroup.getArea();
+			break;
+		}
+
+		Ray scattered;
+		flt pdf_rev_dir;
+		if (mat->_type == GLASS) {
+			v._delta = true;
+			if (from_light)
+				beta *= mat->scatterGlassPhoton(ray, v._rec, scattered);
+			else {
+				mat->scatter(ray, v._rec, scattered);
+				beta *= mat->bsdf(scattered.getDirection(), v._rec, wo);
+			}
+			pdf_dir = 0;
+			pdf_rev_dir = 0;
+		}
+		else {
+			v._rec._normal = glm::dot(v._rec._normal, wo) > 0 ? v._rec._normal : -v._rec._normal;
+			if (n == max_vertices)
+				break;
+			pdf_dir = mat->scatter(ray, v._rec, scattered);
+			glm::vec3 wi = scattered.getDirection();
+			flt cos = glm::dot(wi, v._rec._normal);
+			if (cos <= 0 || pdf_dir <= kEps)
+				break;
+			beta *= mat->bsdf(wi, v._rec, wo) * cos / pdf_dir;
+			pdf_rev_dir = mat->pdf(wo, v._rec, wi);
+		}
+		prev._pdf_rev = toArea(pdf_rev_dir, v, prev);
+		scattered.setCone(ray.coneWidthAt(v._rec._t), ray.getConeSpread());
+		ray = scattered;
+	}
+	return n;
+}
+
+int BidirectionalRender::lightSubpath(Scene& scene, PathVertex* path, int max_vertices)
+{
+	PathVertex& y0 = path[0];
+	y0 = PathVertex();
+	flt pdf_pos = scene.egroup.sampleSurface(y0._rec);
+	if (pdf_pos <= 0 || !y0._rec._mat)
+		return 0;
+	y0._light = true;
+	y0._pdf_fwd = pdf_pos;
+	y0._beta = y0._rec._mat->_ke / pdf_pos;
+	if (max_vertices == 1)
+		return 1;
+
+	glm::vec3 dir = random_cosine_direction(y0._rec._normal);
+	flt pdf_dir = glm::dot(dir, y0._rec._normal) / pi;
+	if (pdf_dir <= kEps)
+		return 1;
+	// the cosine over the direction pdf leaves pi
+	return randomWalk(scene, Ray(y0.pos(), dir), y0._beta * pi, pdf_dir, path, max_vertices, true);
+}
+
+// Balance heuristic over the strategies that build the same path with other
+// splits between the subpaths. The densities at the connection are only known
+// now and are set for the duration of the call.
+flt BidirectionalRender::misWeight(PathVertex* light, int s, PathVertex* camera, int t)
+{
+	PathVertex* qs = s > 0 ? &light[s - 1] : NULL;
+	PathVertex* qs_prev = s > 1 ? &light[s - 2] : NULL;
+	PathVertex* pt = &camera[t - 1];
+	PathVertex* pt_prev = &camera[t - 2];
+
+	flt saved_pt = pt->_pdf_rev, saved_pt_prev = pt_prev->_pdf_rev;
+	flt saved_qs = qs ? qs->_pdf_rev : 0, saved_qs_prev = qs_prev ? qs_prev->_pdf_rev : 0;
+	if (s == 0) {
+		// pt->_pdf_rev already holds the density of sampling it on the emitters
+		pt_prev->_pdf_rev = pdfArea(*pt, NULL, *pt_prev);
+	}
+	else {
+		pt->_pdf_rev = pdfArea(*qs, qs_prev, *pt);
+		pt_prev->_pdf_rev = pdfArea(*pt, qs, *pt_prev);
+		qs->_pdf_rev = pdfArea(*pt, pt_prev, *qs);
+		if (qs_prev)
+			qs_prev->_pdf_rev = pdfArea(*qs, pt, *qs_prev);
+	}
+
+	flt sum = 0;
+	flt ri = 1;
+	for (int i = t - 1; i > 1; i--) {
+		ri *= remap0(camera[i]._pdf_rev) / remap0(camera[i]._pdf_fwd);
+		if (!camera[i]._delta && !camera[i - 1]._delta)
+			sum += ri;
+	}
+	ri = 1;
+	for (int i = s - 1; i >= 0; i--) {
+		ri *= remap0(light[i]._pdf_rev) / remap0(light[i]._pdf_fwd);
+		if (!light[i]._delta && (i == 0 || !light[i - 1]._delta))
+			sum += ri;
+	}
+
+	pt->_pdf_rev = saved_pt;
+	pt_prev->_pdf_rev = saved_pt_prev;
+	if (qs)
+		qs->_pdf_rev = saved_qs;
+	if (qs_prev)
+		qs_prev->_pdf_rev = saved_qs_prev;
+	return 1 / (1 + sum);
+}
+
+// Path made of the first s light and the first t camera vertices, t >= 2.
+glm::vec3 BidirectionalRender::connect(Scene& scene, PathVertex* light, int s, PathVertex* camera, int t)
+{
+	PathVertex& pt = camera[t - 1];
+	glm::vec3 L(0.0f);
+	if (s == 0) {
+		if (!pt._light)
+			return L;
+		L = pt._beta * pt._rec._mat->_ke;
+	}
+	else {
+		PathVertex& qs = light[s - 1];
+		// emitters absorb, as in Scene::Li: a light subpath ending on one reflects nothing
+		if (pt._delta || qs._delta || pt._rec._mat->_type == LIGHT || (s > 1 && qs._rec._mat->_type == LIGHT))
+			return L;
+		glm::vec3 d = qs.pos() - pt.pos();
+		flt dist = glm::length(d);
+		if (dist <= kHitEps)
+			return L;
+		glm::vec3 w = d / dist;
+		flt cos_pt = glm::dot(pt._rec._normal, w);
+		flt cos_qs = -glm::dot(qs._rec._normal, w);
+		if (cos_pt <= 0 || cos_qs <= 0)
+			return L;
+
+		glm::vec3 f_pt = pt._rec._mat->bsdf(w, pt._rec, glm::normalize(camera[t - 2].pos() - pt.pos()));
+		glm::vec3 f_qs(1.0f);	// emitters radiate uniformly, their radiance is in _beta
+		if (s > 1)
+			f_qs = qs._rec._mat->bsdf(glm::normalize(light[s - 2].pos() - qs.pos()), qs._rec, -w);
+		L = qs._beta * f_qs * f_pt * pt._beta * (cos_pt * cos_qs / (dist * dist));
+		if (glm::compMax(L) <= 0)
+			return glm::vec3(0.0f);
+
+		STAT_INC(STAT_SHADOW_RAYS);
+		HitRecord tmp;
+		if (scene.bvh_tree.hit(Ray(pt.pos(), w), kHitEps, dist * (1 - 1e-4f), tmp))
+			return glm::vec3(0.0f);
+	}
+	return L * misWeight(light, s, camera, t);
+}
+
+glm::vec3 BidirectionalRender::Li(Scene& scene, const Ray& camera_ray, int maxdepth)
+{
+	// paths of up to maxdepth + 1 segments, as many as Scene::Li reaches with its last light sample
+	int max_camera = glm::min(maxdepth + 2, kMaxVertices);
+	int max_light = glm::min(maxdepth + 1, kMaxVertices);
+	PathVertex camera[kMaxVertices], light[kMaxVertices];
+
+	STAT_INC(STAT_CAMERA_RAYS);
+	camera[0] = PathVertex();
+	camera[0]._rec._pos = camera_ray.getOrigin();
+	camera[0]._rec._normal = camera_ray.getDirection();
+	camera[0]._beta = glm::vec3(1.0f);
+	glm::vec3 L(0.0f);
+	int num_camera = randomWalk(scene, camera_ray, glm::vec3(1.0f), 1.0f, camera, max_camera, false, &L);
+	int num_light = lightSubpath(scene, light, max_light);
+
+	for (int t = 2; t <= num_camera; t++) {
+		for (int s = 0; s <= num_light && s + t <= max_camera; s++) {
+			glm::vec3 c = connect(scene, light, s, camera, t);
+			if (std::isfinite(c.x) && std::isfinite(c.y) && std::isfinite(c.z))
+				L += c;
+		}
+	}
+	return L;
+}
+
+// Renders spp passes with Scene::Li, then as many bidirectional passes as fit
+// in the same time, and writes both images to ./output/.
+void BidirectionalRender::benchmark(Scene& scene, int spp, int maxdepth)
+{
+	std::string integrator = scene.settings._integrator;
+
+	scene.settings._integrator = "path";
+	scene.buf.clear();
+	random_seed(scene.settings._seed);
+	double start = omp_get_wtime();
+	for (int s = 0; s < spp; s++)
+		scene.renderSample(s, maxdepth);
+	double budget = omp_get_wtime() - start;
+	scene.buf.renderToPic("./output/bench_path.jpg", 2.2, spp);
+	INFO("path %8.3f s  %5d spp  ./output/bench_path.jpg\n", budget, spp);
+
+	scene.settings._integrator = "bdpt";
+	scene.buf.clear();
+	start = omp_get_wtime();
+	int passes = 0;
+	while (passes == 0 || omp_get_wtime() - start < budget)
+		scene.renderSample(passes++, maxdepth);
+	scene.buf.renderToPic("./output/bench_bdpt.jpg", 2.2, passes);
+	INFO("bdpt %8.3f s  %5d spp  ./output/bench_bdpt.jpg\n", omp_get_wtime() - start, passes);
+
+	scene.settings._integrator = integrator;
+}
@@ -0,0 +1,45 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Ray.hpp"
+#include "Model.hpp"
+
+class Scene;
+
+// Vertex of a camera or light subpath. Both densities are per unit area at
+// this vertex: _pdf_fwd for how the subpath reached it, _pdf_rev for how the
+// other subpath would have.
+class PathVertex
+{
+public:
+	HitRecord _rec;	// normal faces the side the subpath came from
+	glm::vec3 _beta;	// subpath throughput up to and including this vertex
+	flt _pdf_fwd = 0;
+	flt _pdf_rev = 0;
+	bool _delta = false;	// glass, cannot be connected
+	bool _light = false;	// lies on an emitter
+
+	inline const glm::vec3& pos() const { return _rec._pos; }
+};
+
+// Bidirectional path tracer. Every camera sample also traces a light subpath
+// from a point sampled uniformly on the emitters, and all pairs of their
+// non-glass vertices are connected with a shadow ray. The strategies are
+// combined with the balance heuristic. Connecting to the camera itself is left
+// out, so every strategy lands in the pixel being rendered. Light subpaths never
+// start on the environment map, so camera subpaths that escape to it are the
+// only strategy for that light and count with weight 1.
+class BidirectionalRender
+{
+public:
+	static glm::vec3 Li(Scene& scene, const Ray& camera_ray, int maxdepth);
+	static void benchmark(Scene& scene, int spp, int maxdepth);
+
+private:
+	static int randomWalk(Scene& scene, Ray ray, glm::vec3 beta, flt pdf_dir, PathVertex* path, int max_vertices, bool from_light,
+		glm::vec3* escaped = NULL);
+	static int lightSubpath(Scene& scene, PathVertex* path, int max_vertices);
+	static glm::vec3 connect(Scene& scene, PathVertex* light, int s, PathVertex* camera, int t);
+	static flt misWeight(PathVertex* light, int s, PathVertex* camera, int t);
+};
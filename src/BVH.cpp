@@ -1,6 +1,9 @@
 // Author: Peiyao Li
 // Date:   Mar 1 2023
 #include "BVH.hpp"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 static glm::vec3* s_centers;
 static BOX* s_boxes;
@@ -15,6 +18,7 @@ void BvhNode::construct(unsigned int id)
 
 void BvhNode::construct(unsigned int* lst, unsigned int num)
 {
+	_box.init();
 	for (unsigned int i = 0; i < num; i++)
 		_box += s_boxes[lst[i]];
 
@@ -145,26 +149,47 @@ int BvhNode::hit(const Ray& ray, flt tmin, flt tmax, HitRecord& rec)
 
 Bvh::Bvh(const std::vector<Hittable*> objects)
 {
+	_num = 0;
+	_nodes = NULL;
 	buildTree(objects);
 }
 
 void Bvh::buildTree(const std::vector<Hittable*>& objects)
 {
+	if (_nodes) delete[] _nodes;
 	_num = 0;
 	_nodes = NULL;
 
-	construct(objects);
+	if (_builder == BVH_SPATIAL)
+		constructSpatial(objects);
+	else if (_builder == BVH_MORTON)
+		constructMorton(objects);
+	else
+		construct(objects);
 	reorder();
 	getRoot()->resetParents(_nodes); //update the parents after reorder ...
 	setObjects(objects);
+	computeLevels();
+	flatten();
 
-	if (s_boxes) delete s_boxes;
+	if (s_boxes) delete[] s_boxes;
+	s_boxes = NULL;
+}
+
+BvhBuilder Bvh::builderFromName(const std::string& name)
+{
+	if (name == "midpoint") return BVH_MIDPOINT;
+	if (name == "sbvh") return BVH_SPATIAL;
+	if (name == "lbvh") return BVH_MORTON;
+	ERRORM("Unknown BVH builder %s\n", name.c_str());
+	return BVH_MIDPOINT;
 }
 
 void Bvh::construct(const std::vector<Hittable*>& objects)
 {
 	_objects = objects;
 	BOX total;
+	total.init();
 	_num = objects.size();
 
 	s_centers = new glm::vec3[_num];
@@ -232,6 +257,54 @@ void Bvh::refit()
 	getRoot()->refit();
 }
 
+// Refit after the objects moved: leaves take the new object boxes, then the
+// levels are merged bottom-up, every level in parallel.
+void Bvh::refitObjects()
+{
+	if (!_nodes) {
+		ERRORM("Cannot refit a BVH without its build nodes\n");
+	}
+	for (int l = int(_level_offsets.size()) - 2; l >= 0; l--) {
+		int begin = _level_offsets[l], end = _level_offsets[l + 1];
+#pragma omp parallel for num_threads(_threads) schedule(static)
+		for (int i = begin; i < end; i++) {
+			BvhNode& node = _nodes[i];
+			if (node.isLeaf())
+				node._box = node._object->boundingbox();
+			else
+				node._box = node.left()->_box + node.right()->_box;
+		}
+	}
+	flatten();
+}
+
+// Surface area heuristic of the whole tree relative to the root, with unit
+// traversal and intersection costs. Used to decide when a refit tree has to be rebuilt.
+flt Bvh::sahCost()
+{
+	flt root_area = _nodes[0]._box.area();
+	if (root_area <= 0) return 0;
+	double cost = 0;
+	for (int i = 0; i < _num * 2 - 1; i++)
+		cost += _nodes[i]._box.area();
+	return flt(cost / root_area);
+}
+
+void Bvh::computeLevels()
+{
+	std::vector<int> depth(_num * 2 - 1, 0);
+	_level_offsets.assign(1, 0);
+	for (int i = 0; i < _num * 2 - 1; i++) {
+		if (depth[i] >= int(_level_offsets.size()))
+			_level_offsets.push_back(i);
+		if (!_nodes[i].isLeaf()) {
+			depth[_nodes[i].left() - _nodes] = depth[i] + 1;
+			depth[_nodes[i].right() - _nodes] = depth[i] + 1;
+		}
+	}
+	_level_offsets.push_back(_num * 2 - 1);
+}
+
 void Bvh::reorder()
 {
 	if (true)
@@ -285,19 +358,312 @@ void Bvh::travel()
 	getRoot()->travel();
 }
 
+// Subtrees become leaves of the compact layout when that is cheaper under the
+// SAH (unit intersection cost, kTraversalCost per node) and they fit in a leaf.
+static const flt kTraversalCost = 1.0f;
+
+static flt collapseCost(BvhNode* node, BvhNode* root, std::vector<char>& collapse, int& count)
+{
+	if (node->isLeaf()) {
+		count = 1;
+		collapse[node - root] = 1;
+		return 1;
+	}
+	int count_l, count_r;
+	flt cost_l = collapseCost(node->left(), root, collapse, count_l);
+	flt cost_r = collapseCost(node->right(), root, collapse, count_r);
+	count = count_l + count_r;
+
+	flt area = node->box().area();
+	flt cost = kTraversalCost;
+	if (area > 0)
+		cost += (node->left()->box().area() * cost_l + node->right()->box().area() * cost_r) / area;
+	else
+		cost += cost_l + cost_r;
+
+	if (count <= CompactNode::kMaxLeafSize && count <= cost) {
+		collapse[node - root] = 1;
+		return flt(count);
+	}
+	return cost;
+}
+
+static void quantize(CompactNode& cn, const AABB& box, const AABB child[2])
+{
+	glm::vec3 lo = box.getMin(), hi = box.getMax();
+	for (int a = 0; a < 3; a++) {
+		int e;
+		frexpf((hi[a] - lo[a]) / 255.0f, &e);	// 255 * 2^e covers the extent
+		e = glm::clamp(e, -126, 127);
+		flt scale = ldexpf(1.0f, e);
+		cn._origin[a] = lo[a];
+		cn._exp[a] = int8_t(e);
+		for (int c = 0; c < 2; c++) {
+			flt qlo = floorf((child[c].getMin()[a] - lo[a]) / scale);
+			flt qhi = ceilf((child[c].getMax()[a] - lo[a]) / scale);
+			cn._qlo[c][a] = uint8_t(glm::clamp(qlo, 0.0f, 255.0f));
+			cn._qhi[c][a] = uint8_t(glm::clamp(qhi, 0.0f, 255.0f));
+		}
+	}
+}
+
+void Bvh::emitPrims(BvhNode* node)
+{
+	if (node->isLeaf()) {
+		_prims.push_back(node->getID());
+		return;
+	}
+	emitPrims(node->left());
+	emitPrims(node->right());
+}
+
+void Bvh::flattenNode(BvhNode* node, const std::vector<char>& collapse, int depth)
+{
+	_stack_size = std::max(_stack_size, depth + 1);
+	int idx = int(_compact.size());
+	_compact.emplace_back();
+
+	BvhNode* child[2] = { node->left(), node->right() };
+	AABB boxes[2] = { child[0]->box(), child[1]->box() };
+	quantize(_compact[idx], node->box(), boxes);
+
+	uint8_t meta = 0;
+	uint32_t first_leaf = 0, right_node = 0;
+	for (int c = 0; c < 2; c++) {
+		if (collapse[child[c] - _nodes]) {
+			uint32_t first = uint32_t(_prims.size());
+			emitPrims(child[c]);
+			meta |= uint8_t(1 << c);
+			meta |= uint8_t((_prims.size() - first - 1) << (2 + 3 * c));
+			if (c == 0 || !(meta & 1))
+				first_leaf = first;
+		}
+		else {
+			if (c == 1)
+				right_node = uint32_t(_compact.size());
+			flattenNode(child[c], collapse, depth + 1);
+		}
+	}
+	_compact[idx]._meta = meta;
+	_compact[idx]._child = (meta & 3) ? first_leaf : right_node;
+}
+
+void Bvh::flatten()
+{
+	_compact.clear();
+	_prims.clear();
+	_bounds = _nodes[0]._box;
+	if (_num == 1) {
+		_prims.push_back(0);
+		return;
+	}
+	std::vector<char> collapse(_num * 2 - 1, 0);
+	int count;
+	collapseCost(getRoot(), _nodes, collapse, count);
+	collapse[0] = 0;	// the root always gets a node
+	_compact.reserve(_num);
+	_stack_size = 0;
+	flattenNode(getRoot(), collapse, 1);
+	_compact.shrink_to_fit();
+}
+
+// Static trees only need the compact layout, the build nodes are kept for refitting.
+void Bvh::releaseBuildNodes()
+{
+	if (_nodes) delete[] _nodes;
+	_nodes = NULL;
+	_level_offsets.clear();
+}
+
 bool Bvh::hit(const Ray& r, flt tmin, flt tmax, HitRecord& rec)
 {
-	flt t_hit = FLT_MAX;
-	int obj_idx = _nodes->hit(r, tmin, tmax, rec);
-	if (obj_idx >= 0)
-	{
-		//return true;
-		bool flag = _objects[obj_idx]->hit(r, tmin, tmax, rec);
-		return flag;
+	bool hit_any = false;
+	HitRecord tmp;
+	if (_compact.empty()) {
+		for (unsigned int prim : _prims) {
+			if (_objects[prim]->hit(r, tmin, tmax, tmp)) {
+				tmax = tmp._t;
+				rec = tmp;
+				hit_any = true;
+			}
+		}
+		return hit_any;
+	}
+
+	glm::vec3 org = r.getOrigin();
+	glm::vec3 inv_dir = 1.0f / r.getDirection();
+	int local_stack[kStackSize];
+	std::vector<int> deep_stack;
+	int* stack = local_stack;
+	if (_stack_size > kStackSize) {
+		deep_stack.resize(_stack_size);
+		stack = deep_stack.data();
 	}
-	return false;
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const CompactNode& node = _compact[stack[--top]];
+		STAT_INC(STAT_BVH_NODES);
+		flt scale[3] = { node.scale(0), node.scale(1), node.scale(2) };
+		flt tnear[2];
+		bool hit_child[2];
+		for (int c = 0; c < 2; c++) {
+			flt t0 = tmin, t1 = tmax;
+			for (int a = 0; a < 3; a++) {
+				flt lo = node._origin[a] + node._qlo[c][a] * scale[a];
+				flt hi = node._origin[a] + node._qhi[c][a] * scale[a];
+				flt ta = (lo - org[a]) * inv_dir[a];
+				flt tb = (hi - org[a]) * inv_dir[a];
+				if (ta > tb) std::swap(ta, tb);
+				t0 = ta > t0 ? ta : t0;
+				t1 = tb * 1.0000003f < t1 ? tb * 1.0000003f : t1;
+			}
+			hit_child[c] = t0 <= t1;
+			tnear[c] = t0;
+		}
+
+		int pushed[2], num_pushed = 0;
+		for (int c = 0; c < 2; c++) {
+			if (!hit_child[c])
+				continue;
+			if (node.isLeaf(c)) {
+				uint32_t first = node._child + ((c == 1 && node.isLeaf(0)) ? node.leafSize(0) : 0);
+				for (uint32_t i = first; i < first + node.leafSize(c); i++) {
+					if (_objects[_prims[i]]->hit(r, tmin, tmax, tmp)) {
+						tmax = tmp._t;
+						rec = tmp;
+						hit_any = true;
+					}
+				}
+			}
+			else {
+				int left = int(&node - _compact.data()) + 1;
+				pushed[num_pushed++] = c == 0 ? left : (node.isLeaf(0) ? left : int(node._child));
+			}
+		}
+		// visit the nearer child first
+		if (num_pushed == 2 && tnear[0] < tnear[1])
+			std::swap(pushed[0], pushed[1]);
+		for (int i = 0; i < num_pushed; i++)
+			stack[top++] = pushed[i];
+	}
+	return hit_any;
 }
 
+static inline int lowestBit(uint32_t m)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward(&i, m);
+	return int(i);
+#else
+	return __builtin_ctz(m);
+#endif
+}
+
+void Bvh::occluded(const glm::vec3& org, const glm::vec3* dirs, const flt* tmax, int count, flt tmin, bool* blocked)
+{
+	if (count > kMaxShadowBatch) {
+		for (int first = 0; first < count; first += kMaxShadowBatch)
+			occluded(org, dirs + first, tmax + first, std::min(count - first, int(kMaxShadowBatch)), tmin, blocked + first);
+		return;
+	}
+	Ray rays[kMaxShadowBatch];
+	glm::vec3 inv_dir[kMaxShadowBatch];
+	uint32_t active = 0;
+	for (int i = 0; i < count; i++) {
+		rays[i].setOrigin(org);
+		rays[i].setDirection(dirs[i]);
+		inv_dir[i] = 1.0f / dirs[i];
+		blocked[i] = false;
+		active |= 1u << i;
+	}
+	HitRecord tmp;
+	if (_compact.empty()) {
+		for (unsigned int prim : _prims) {
+			for (int i = 0; i < count; i++) {
+				if (!blocked[i] && _objects[prim]->hit(rays[i], tmin, tmax[i], tmp))
+					blocked[i] = true;
+			}
+		}
+		return;
+	}
+
+	// any hit will do, so children are visited in stack order and each entry
+	// carries the rays that reached it
+	int local_stack[kStackSize];
+	uint32_t local_masks[kStackSize];
+	std::vector<int> deep_stack;
+	std::vector<uint32_t> deep_masks;
+	int* stack = local_stack;
+	uint32_t* masks = local_masks;
+	if (_stack_size > kStackSize) {
+		deep_stack.resize(_stack_size);
+		deep_masks.resize(_stack_size);
+		stack = deep_stack.data();
+		masks = deep_masks.data();
+	}
+	int top = 0;
+	stack[top] = 0;
+	masks[top++] = active;
+
+	while (top > 0 && active) {
+		--top;
+		uint32_t mask = masks[top] & active;
+		if (!mask)
+			continue;
+		const CompactNode& node = _compact[stack[top]];
+		STAT_INC(STAT_BVH_NODES);
+		flt scale[3] = { node.scale(0), node.scale(1), node.scale(2) };
+		// box planes relative to the shared origin, decoded once for all rays
+		flt lo[2][3], hi[2][3];
+		for (int c = 0; c < 2; c++) {
+			for (int a = 0; a < 3; a++) {
+				lo[c][a] = node._origin[a] + node._qlo[c][a] * scale[a] - org[a];
+				hi[c][a] = node._origin[a] + node._qhi[c][a] * scale[a] - org[a];
+			}
+		}
+		uint32_t child_mask[2] = { 0, 0 };
+		for (uint32_t m = mask; m; m &= m - 1) {
+			int i = lowestBit(m);
+			for (int c = 0; c < 2; c++) {
+				flt t0 = tmin, t1 = tmax[i];
+				for (int a = 0; a < 3; a++) {
+					flt ta = lo[c][a] * inv_dir[i][a];
+					flt tb = hi[c][a] * inv_dir[i][a];
+					if (ta > tb) std::swap(ta, tb);
+					t0 = ta > t0 ? ta : t0;
+					t1 = tb * 1.0000003f < t1 ? tb * 1.0000003f : t1;
+				}
+				if (t0 <= t1)
+					child_mask[c] |= 1u << i;
+			}
+		}
+
+		for (int c = 0; c < 2; c++) {
+			if (!child_mask[c])
+				continue;
+			if (node.isLeaf(c)) {
+				uint32_t first = node._child + ((c == 1 && node.isLeaf(0)) ? node.leafSize(0) : 0);
+				for (uint32_t p = first; p < first + node.leafSize(c); p++) {
+					for (uint32_t m = child_mask[c] & active; m; m &= m - 1) {
+						int i = lowestBit(m);
+						if (_objects[_prims[p]]->hit(rays[i], tmin, tmax[i], tmp)) {
+							blocked[i] = true;
+							active &= ~(1u << i);
+						}
+					}
+				}
+			}
+			else {
+				int left = int(&node - _compact.data()) + 1;
+				stack[top] = c == 0 ? left : (node.isLeaf(0) ? left : int(node._child));
+				masks[top++] = child_mask[c];
+			}
+		}
+	}
+}
 
 AAP::AAP(const BOX& total) {
 	glm::vec3 center = total.center();
@@ -4,8 +4,34 @@
 #include "Global.hpp"
 #include "Model.hpp"
 #include "AABB.hpp"
+#include "Stats.hpp"
+#include <cstring>
 #define BOX AABB
 
+const int kMortonBitsPerAxis = 21;
+
+// spread the lower 21 bits of v so that two zero bits separate each of them
+inline unsigned long long expandBits(unsigned long long v)
+{
+	v &= 0x1fffff;
+	v = (v | v << 32) & 0x1f00000000ffffULL;
+	v = (v | v << 16) & 0x1f0000ff0000ffULL;
+	v = (v | v << 8) & 0x100f00f00f00f00fULL;
+	v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+	v = (v | v << 2) & 0x1249249249249249ULL;
+	return v;
+}
+
+// 63 bit Morton code of a point in the unit cube
+inline unsigned long long mortonCode(const glm::vec3& p)
+{
+	const flt scale = flt((1 << kMortonBitsPerAxis) - 1);
+	unsigned long long x = (unsigned long long)(glm::clamp(p.x, 0.0f, 1.0f) * scale);
+	unsigned long long y = (unsigned long long)(glm::clamp(p.y, 0.0f, 1.0f) * scale);
+	unsigned long long z = (unsigned long long)(glm::clamp(p.z, 0.0f, 1.0f) * scale);
+	return expandBits(x) << 2 | expandBits(y) << 1 | expandBits(z);
+}
+
 class AAP {
 public:
 	char _xyz;
@@ -46,30 +72,103 @@ public:
 	friend class Bvh;
 };
 
+// 32 byte traversal node. Both child boxes are quantized to 8 bits relative to
+// this node's box (origin + power of two scale per axis). Nodes are stored
+// depth-first: an internal left child follows its parent, _child holds the
+// right child index or, for leaf children, the first entry in the primitive
+// index array (a right leaf follows a left leaf there).
+class CompactNode
+{
+public:
+	float _origin[3];
+	int8_t _exp[3];
+	uint8_t _meta;	// bit 0/1 left/right is leaf, bits 2-4/5-7 left/right leaf size - 1
+	uint8_t _qlo[2][3];
+	uint8_t _qhi[2][3];
+	uint32_t _child;
+
+	static const int kMaxLeafSize = 8;
+
+	// 2^e built straight from the exponent bits, e is within the normal range
+	inline flt scale(int a) const
+	{
+		uint32_t bits = uint32_t(_exp[a] + 127) << 23;
+		flt s;
+		memcpy(&s, &bits, sizeof(s));
+		return s;
+	}
+	inline bool isLeaf(int c) const { return (_meta >> c) & 1; }
+	inline int leafSize(int c) const { return ((_meta >> (2 + 3 * c)) & 7) + 1; }
+};
+
+enum BvhBuilder { BVH_MIDPOINT, BVH_SPATIAL, BVH_MORTON };
+
 class Bvh {
 private:
-	int _num;
+	int _num;	// number of leaves, more than the objects when spatial splits duplicated some
 	BvhNode* _nodes;
 	std::vector<Hittable*> _objects;
+	std::vector<int> _level_offsets; // breadth-first order keeps every depth contiguous
+
+	// traversal layout, rebuilt from _nodes by flatten()
+	std::vector<CompactNode> _compact;
+	std::vector<unsigned int> _prims;
+	AABB _bounds;
+	int _stack_size = 0;	// entries a traversal can hold at once, one more than the compact depth
+
+	static const int kStackSize = 128;	// traversal stack on the call stack, deeper trees allocate one
+
+	BvhBuilder _builder = BVH_MIDPOINT;
+	flt _split_growth = 0.5f;	// spatial splits may add this fraction of the objects as extra references
+	int _threads = 1;	// for the Morton build and the refit
+
+	void constructSpatial(const std::vector<Hittable*>& objects);
+	void constructMorton(const std::vector<Hittable*>& objects);
+	void constructMortonRange(const unsigned long long* codes, const unsigned int* ids,
+		int first, int last, int idx, int next);
+	void computeLevels();
+	void flattenNode(BvhNode* node, const std::vector<char>& collapse, int depth);
+	void emitPrims(BvhNode* node);
 
 public:
-	Bvh(){ }
+	Bvh() { _num = 0; _nodes = NULL; }
 	Bvh(const std::vector<Hittable*> objects);
+	// owns _nodes, copies would free them twice
+	Bvh(const Bvh&) = delete;
+	Bvh& operator=(const Bvh&) = delete;
 
 	void buildTree(const std::vector<Hittable*>& objects);
 	void construct(const std::vector<Hittable*>& objects);
+	void setBuilder(BvhBuilder builder, flt split_growth, int threads)
+	{
+		_builder = builder;
+		_split_growth = split_growth;
+		_threads = std::max(threads, 1);
+	}
+	static BvhBuilder builderFromName(const std::string& name);
 	void setObjects(const std::vector<Hittable*>& objects);
 	void refit();
+	void refitObjects();
 	void reorder();	
+	void flatten();
+	void releaseBuildNodes();
+	flt sahCost();
 
 	void travel();
 
 	bool hit(const Ray& r, flt tmin, flt tmax, HitRecord& rec);
+	// Shadow rays from one origin, traced together: every node is fetched and
+	// its child boxes decoded once for the whole batch. Sets blocked[i] when
+	// something lies within (tmin, tmax[i]) along dirs[i] (unit length).
+	static const int kMaxShadowBatch = 32;
+	void occluded(const glm::vec3& org, const glm::vec3* dirs, const flt* tmax, int count, flt tmin, bool* blocked);
 
 	inline BvhNode* getRoot() { return _nodes; }
+	inline const AABB& getBounds() const { return _bounds; }
 	inline int getNum() const { return _num; }
+	inline size_t getCompactBytes() const { return _compact.size() * sizeof(CompactNode) + _prims.size() * sizeof(unsigned int); }
 	inline std::vector<Hittable*>& getObjects() { return _objects; }
 
-	~Bvh() { if (_nodes) delete _nodes; }
+	~Bvh() { if (_nodes) delete[] _nodes; }
 };
 
@@ -31,7 +31,7 @@ void Buffer::setSpp(int spp) {
 void Buffer::clear()
 {
 	for (auto& col : _data) {
-		for (auto pixel : col)
+		for (auto& pixel : col)
 		{
 			pixel = glm::vec3(0, 0, 0);
 		}
@@ -74,4 +74,50 @@ void Buffer::renderToPic(const std::string& output_path, const flt gamma, int sp
     }
     stbi_write_jpg(output_path.c_str(), _width, _height, picChannel, img, 100);
     delete[] img;
-}
\ No newline at end of file
+}
+
+void Buffer::accumulate(const Buffer& other)
+{
+    if (other._width != _width || other._height != _height) {
+        ERRORM("Cannot accumulate buffer %d x %d into %d x %d\n",
+            other._width, other._height, _width, _height);
+    }
+    for (int y = 0; y < _height; y++) {
+        for (int x = 0; x < _width; x++) {
+            _data[y][x] += other._data[y][x];
+        }
+    }
+}
+
+// Layout: magic, width, height, spp, then width * height * 3 floats in scanline order.
+static const int kAccumulationMagic = 0x50504542; // "PPEB"
+
+bool Buffer::saveAccumulation(const std::string& path, int spp) const
+{
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) return false;
+    int header[4] = { kAccumulationMagic, _width, _height, spp };
+    bool ok = fwrite(header, sizeof(int), 4, fp) == 4;
+    for (int y = 0; y < _height && ok; y++) {
+        ok = fwrite(_data[y].data(), sizeof(glm::vec3), _width, fp) == size_t(_width);
+    }
+    fclose(fp);
+    return ok;
+}
+
+bool Buffer::loadAccumulation(const std::string& path, int& spp)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) return false;
+    int header[4];
+    bool ok = fread(header, sizeof(int), 4, fp) == 4 && header[0] == kAccumulationMagic;
+    if (ok) {
+        init(header[1], header[2], header[3]);
+        spp = header[3];
+    }
+    for (int y = 0; y < _height && ok; y++) {
+        ok = fread(_data[y].data(), sizeof(glm::vec3), _width, fp) == size_t(_width);
+    }
+    fclose(fp);
+    return ok;
+}
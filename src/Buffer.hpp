@@ -21,6 +21,12 @@ public:
     void addColor(int x, int y, glm::vec3 color);
     void renderToPic(const std::string& pic_path, const flt gamma, int spp) const;
 
+    // raw float accumulation, used to merge the parts of a distributed render
+    void accumulate(const Buffer& other);
+    bool saveAccumulation(const std::string& path, int spp) const;
+    bool loadAccumulation(const std::string& path, int& spp);
+
+    inline const glm::vec3& getColor(int x, int y) const { return _data[y][x]; }
     inline int getWidth() const { return _width; }
     inline int getHeight() const { return _height; }
 };
\ No newline at end of file
@@ -36,6 +36,14 @@ void Camera::initFromXML(const tinyxml2::XMLDocument& xmlconfig)
 }
 
 
+void Camera::setView(const glm::vec3& eye, const glm::vec3& lookat, const glm::vec3& up)
+{
+    _pos = eye;
+    _lookat = lookat;
+    _up = up;
+    precomputeCamera();
+}
+
 void Camera::precomputeCamera()
 {
     DEBUGM("Camera arguments:\n");
@@ -65,6 +73,7 @@ void Camera::precomputeCamera()
 
     _dposw = (right_top_corner - _left_top_pos) / (1.0f * _width);
     _dposh = (left_bottom_corner - _left_top_pos) / (1.0f * _height);
+    _pixel_spread = atanf(viewport_height / _focal_length / _height);
 
     DEBUGM("left_top_pos: %f %f %f\n", _left_top_pos[0], _left_top_pos[1], _left_top_pos[2]);
     DEBUGM("dw: %f %f %f\n", _dposw[0], _dposw[1], _dposw[2]);
@@ -77,6 +86,7 @@ Ray Camera::genRay(int x, int y)
     flt xpos = flt(x + 0.5);
     flt ypos = flt(y + 0.5);
     Ray ray(_pos, _left_top_pos + glm::vec3(xpos * _dposw + ypos * _dposh) - _pos);
+    ray.setCone(0, _pixel_spread);
     return ray;
 }
 
@@ -86,6 +96,7 @@ Ray Camera::genRayRandom(int x, int y)
     flt ypos = flt(y + random_float());
     glm::vec3 dir = _left_top_pos + glm::vec3(xpos * _dposw + ypos * _dposh) - _pos;
     Ray ray(_pos, _left_top_pos + glm::vec3(xpos * _dposw + ypos * _dposh) - _pos);
+    ray.setCone(0, _pixel_spread);
     return ray;
 }
 
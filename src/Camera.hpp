@@ -18,6 +18,7 @@ private:
 
 	glm::vec3 _left_top_pos;
 	glm::vec3 _dposw, _dposh;
+	flt _pixel_spread; // spread angle of the ray cone through one pixel
 
 public:
 	Camera() {}
@@ -30,9 +31,13 @@ public:
 	}
 	void initFromXML(const tinyxml2::XMLDocument& xmlconfig);
 	void precomputeCamera();	
+	void setView(const glm::vec3& eye, const glm::vec3& lookat, const glm::vec3& up);
 	
 	inline int getWidth() const { return _width; }
 	inline int getHeight() const { return _height; }
+	inline glm::vec3 getEye() const { return _pos; }
+	inline glm::vec3 getLookat() const { return _lookat; }
+	inline glm::vec3 getUp() const { return _up; }
 	Ray genRay(int x, int y);
 	Ray genRayRandom(int x, int y);
 };
@@ -0,0 +1,157 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "Denoiser.hpp"
+
+namespace {
+
+const int kLevels = 5;
+const flt kKernel[3] = { 3.0f / 8, 1.0f / 4, 1.0f / 16 };	// B3 spline, by distance from the center tap
+const flt kSigmaLuminance = 4.0f;
+const flt kSigmaNormal = 128.0f;
+const flt kSigmaDepth = 0.05f;	// relative depth change per pixel of distance
+const flt kSigmaAlbedo = 0.1f;
+const flt kMinAlbedo = 1e-3f;
+
+class Pixel
+{
+public:
+	glm::vec3 _color;	// demodulated
+	glm::vec3 _albedo;
+	glm::vec3 _normal;	// zero where every feature ray missed
+	flt _depth;
+	flt _variance;	// of the luminance of _color
+};
+
+inline flt luminance(const glm::vec3& c)
+{
+	return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+inline flt geometryWeight(const Pixel& p, const Pixel& q, flt dist)
+{
+	bool p_miss = p._normal == glm::vec3(0), q_miss = q._normal == glm::vec3(0);
+	if (p_miss || q_miss)
+		return p_miss && q_miss ? 1.0f : 0.0f;
+	flt wn = powf(glm::max(0.0f, glm::dot(p._normal, q._normal)), kSigmaNormal);
+	flt wz = expf(-fabsf(p._depth - q._depth) / (kSigmaDepth * p._depth * dist + 1e-6f));
+	glm::vec3 da = p._albedo - q._albedo;
+	flt wa = expf(-glm::dot(da, da) / (kSigmaAlbedo * kSigmaAlbedo));
+	return wn * wz * wa;
+}
+
+// spatial luminance variance over a 5x5 window, restricted to the same surface and albedo
+void estimateVariance(std::vector<Pixel>& pixels, int w, int h, int threads)
+{
+	std::vector<flt> variance(pixels.size());
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 4)
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			const Pixel& p = pixels[size_t(y) * w + x];
+			flt sum_w = 0, sum_l = 0, sum_l2 = 0;
+			for (int dy = -2; dy <= 2; dy++) {
+				for (int dx = -2; dx <= 2; dx++) {
+					int qx = x + dx, qy = y + dy;
+					if (qx < 0 || qy < 0 || qx >= w || qy >= h)
+						continue;
+					const Pixel& q = pixels[size_t(qy) * w + qx];
+					flt weight = geometryWeight(p, q, sqrtf(flt(dx * dx + dy * dy)));
+					flt l = luminance(q._color);
+					sum_w += weight;
+					sum_l += weight * l;
+					sum_l2 += weight * l * l;
+				}
+			}
+			flt mean = sum_l / sum_w;
+			variance[size_t(y) * w + x] = glm::max(0.0f, sum_l2 / sum_w - mean * mean);
+		}
+	}
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i]._variance = variance[i];
+}
+
+void filterLevel(const std::vector<Pixel>& src, std::vector<Pixel>& dst, int w, int h, int step, int threads)
+{
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 4)
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			const Pixel& p = src[size_t(y) * w + x];
+			flt l = luminance(p._color);
+			flt sigma_l = kSigmaLuminance * sqrtf(p._variance) + 1e-6f;
+			glm::vec3 sum_color(0);
+			flt sum_w = 0, sum_var = 0;
+			for (int dy = -2; dy <= 2; dy++) {
+				for (int dx = -2; dx <= 2; dx++) {
+					int qx = x + dx * step, qy = y + dy * step;
+					if (qx < 0 || qy < 0 || qx >= w || qy >= h)
+						continue;
+					const Pixel& q = src[size_t(qy) * w + qx];
+					flt dist = step * sqrtf(flt(dx * dx + dy * dy));
+					flt weight = kKernel[abs(dx)] * kKernel[abs(dy)] * geometryWeight(p, q, dist)
+						* expf(-fabsf(l - luminance(q._color)) / sigma_l);
+					sum_color += weight * q._color;
+					sum_var += weight * weight * q._variance;
+					sum_w += weight;
+				}
+			}
+			Pixel& out = dst[size_t(y) * w + x];
+			out = p;
+			if (sum_w > 0) {
+				out._color = sum_color / sum_w;
+				out._variance = sum_var / (sum_w * sum_w);
+			}
+		}
+	}
+}
+
+}
+
+void FeatureBuffer::init(int w, int h)
+{
+	_width = w;
+	_height = h;
+	_albedo.assign(size_t(w) * h, glm::vec3(0));
+	_normal.assign(size_t(w) * h, glm::vec3(0));
+	_depth.assign(size_t(w) * h, 0);
+	_samples = 0;
+}
+
+void FeatureBuffer::clear()
+{
+	init(_width, _height);
+}
+
+void Denoiser::denoise(const Buffer& color, int spp, const FeatureBuffer& features, Buffer& out, int threads)
+{
+	int w = color.getWidth(), h = color.getHeight();
+	if (features._width != w || features._height != h || features._samples == 0) {
+		ERRORM("Feature buffers do not match the %d x %d image\n", w, h);
+	}
+
+	std::vector<Pixel> pixels(size_t(w) * h), tmp(size_t(w) * h);
+	flt inv_samples = 1.0f / features._samples;
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			size_t i = size_t(y) * w + x;
+			Pixel& p = pixels[i];
+			glm::vec3 n = features._normal[i];
+			p._normal = glm::length(n) > 0 ? glm::normalize(n) : glm::vec3(0);
+			p._albedo = features._albedo[i] * inv_samples;
+			p._depth = features._depth[i] * inv_samples;
+			p._color = color.getColor(x, y) / flt(spp) / glm::max(p._albedo, glm::vec3(kMinAlbedo));
+		}
+	}
+	estimateVariance(pixels, w, h, threads);
+
+	for (int level = 0; level < kLevels; level++) {
+		filterLevel(pixels, tmp, w, h, 1 << level, threads);
+		pixels.swap(tmp);
+	}
+
+	out.init(w, h, 1);
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			const Pixel& p = pixels[size_t(y) * w + x];
+			out.setColor(x, y, p._color * glm::max(p._albedo, glm::vec3(kMinAlbedo)));
+		}
+	}
+}
@@ -0,0 +1,37 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Buffer.hpp"
+
+// First hit features, summed over the feature passes like Buffer sums colors.
+class FeatureBuffer
+{
+public:
+	int _width = 0, _height = 0;
+	int _samples = 0;
+	std::vector<glm::vec3> _albedo;
+	std::vector<glm::vec3> _normal;
+	std::vector<flt> _depth;
+
+	void init(int w, int h);
+	void clear();
+	inline void add(int x, int y, const glm::vec3& albedo, const glm::vec3& normal, flt depth)
+	{
+		size_t i = size_t(y) * _width + x;
+		_albedo[i] += albedo;
+		_normal[i] += normal;
+		_depth[i] += depth;
+	}
+};
+
+// Edge-avoiding a-trous wavelet filter. The color is divided by the albedo so
+// textures survive, then smoothed over five levels of a 5x5 B3 spline kernel
+// with taps weighted by normal, depth, albedo and luminance similarity. The
+// luminance tolerance follows a local variance estimate that shrinks at every
+// level.
+class Denoiser
+{
+public:
+	static void denoise(const Buffer& color, int spp, const FeatureBuffer& features, Buffer& out, int threads);
+};
@@ -0,0 +1,84 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include <thread>
+#include "Distributed.hpp"
+#include "Scene.hpp"
+
+std::string DistributedRender::partPath(const RenderSettings& settings, int worker)
+{
+    return settings._part_dir + "part_" + std::to_string(worker) + ".bin";
+}
+
+void DistributedRender::renderPart(Scene& scene)
+{
+    const RenderSettings& settings = scene.settings;
+    int sbegin = settings.sampleBegin(settings._worker_id);
+    int send = settings.sampleEnd(settings._worker_id);
+    INFO("Worker %d / %d: samples [%d, %d)\n", settings._worker_id, settings._workers, sbegin, send);
+
+    scene.renderRange(sbegin, send, settings._max_depth);
+
+    std::string path = partPath(settings, settings._worker_id);
+    if (!scene.buf.saveAccumulation(path, send - sbegin)) {
+        ERRORM("Cannot write part file %s\n", path.c_str());
+    }
+    INFO("Worker %d wrote %s\n", settings._worker_id, path.c_str());
+}
+
+static std::string quoteArg(const std::string& arg)
+{
+    return "\"" + arg + "\"";
+}
+
+bool DistributedRender::launchWorkers(const std::string& exe, const RenderSettings& settings)
+{
+    std::vector<int> status(settings._workers, 0);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < settings._workers; w++) {
+        std::string cmd = quoteArg(exe) + " " + quoteArg(settings._scene_dir) + " "
+            + quoteArg(settings._scene_name) + " " + quoteArg(settings._obj_name) + " "
+            + std::to_string(settings._spp) + " " + std::to_string(settings._max_depth);
+        // every option reaches the workers, except the ones that place them
+        for (const auto& option : settings._options) {
+            if (option.first != "workers" && option.first != "worker" && option.first != "partdir")
+                cmd += " --" + option.first + " " + quoteArg(option.second);
+        }
+        cmd += " --workers " + std::to_string(settings._workers)
+            + " --worker " + std::to_string(w)
+            + " --partdir " + quoteArg(settings._part_dir)
+            + " > " + quoteArg(settings._part_dir + "part_" + std::to_string(w) + ".log") + " 2>&1";
+        INFO("Launch worker %d: %s\n", w, cmd.c_str());
+        workers.emplace_back([&status, w, cmd]() { status[w] = std::system(cmd.c_str()); });
+    }
+
+    bool ok = true;
+    for (int w = 0; w < settings._workers; w++) {
+        workers[w].join();
+        if (status[w] != 0) {
+            INFO("Worker %d failed with status %d, see its log in %s\n", w, status[w], settings._part_dir.c_str());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool DistributedRender::mergeParts(const RenderSettings& settings, Buffer& buf, int& spp)
+{
+    spp = 0;
+    for (int w = 0; w < settings._workers; w++) {
+        Buffer part;
+        int part_spp = 0;
+        std::string path = partPath(settings, w);
+        if (!part.loadAccumulation(path, part_spp)) {
+            INFO("Cannot read part file %s\n", path.c_str());
+            return false;
+        }
+        if (w == 0)
+            buf.init(part.getWidth(), part.getHeight());
+        buf.accumulate(part);
+        spp += part_spp;
+    }
+    buf.setSpp(spp);
+    INFO("Merged %d parts, %d samples per pixel\n", settings._workers, spp);
+    return true;
+}
@@ -0,0 +1,22 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Settings.hpp"
+#include "Buffer.hpp"
+
+class Scene;
+
+// Multi-process rendering: every worker renders a disjoint sample range of the
+// same scene and writes its float accumulation to <partdir>/part_<id>.bin.
+// The coordinator either spawns the workers locally or, for workers started by
+// hand on other nodes, only merges the part files from a shared folder.
+class DistributedRender
+{
+public:
+	static std::string partPath(const RenderSettings& settings, int worker);
+
+	static void renderPart(Scene& scene);
+	static bool launchWorkers(const std::string& exe, const RenderSettings& settings);
+	static bool mergeParts(const RenderSettings& settings, Buffer& buf, int& spp);
+};
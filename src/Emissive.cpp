@@ -2,6 +2,7 @@
 // Date:   Mar 1 2023
 #include "Emissive.hpp"
 #include "Model.hpp"
+#include <algorithm>
 
 void EmissiveGroup::init(const std::vector<shared_ptr<Emissive>>& lights)
 {
@@ -35,17 +36,26 @@ flt EmissiveGroup::pdf(const HitRecord& rec, const HitRecord& light_rec)
 
 flt EmissiveGroup::sampleRay(Bvh* bvh_tree, HitRecord& rec, Ray& sample_ray, HitRecord& light_rec)
 {
-	flt ran = random_float();
+	if (_lights.empty())
+		ERRORM("There is no light.");
 	// light sample
-	for (int i = 0; i < _lights.size(); i++)
-	{
-		if (ran <= _weight_sum[i])
-		{
-			_lights[i]->sampleRay(bvh_tree, rec, sample_ray, light_rec);
-			flt _pdf = pdf(rec, light_rec);
-			return _pdf;
-		}
-		
-	}
-	ERRORM("There is no light.");
-}
\ No newline at end of file
+	int i = pick(random_float());
+	_lights[i]->sampleRay(bvh_tree, rec, sample_ray, light_rec);
+	flt _pdf = pdf(rec, light_rec);
+	return _pdf;
+}
+
+flt EmissiveGroup::sampleSurface(HitRecord& light_rec)
+{
+	if (_lights.empty())
+		return 0;
+	_lights[pick(random_float())]->sampleSurface(light_rec);
+	return 1 / getArea();
+}
+
+// first light whose cumulative area share reaches ran
+int EmissiveGroup::pick(flt ran) const
+{
+	int i = int(std::lower_bound(_weight_sum.begin(), _weight_sum.end(), ran) - _weight_sum.begin());
+	return std::min(i, int(_lights.size()) - 1);
+}
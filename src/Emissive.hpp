@@ -14,6 +14,8 @@ public:
 	virtual flt getArea() = 0;
 	virtual flt sampleRay(Bvh* bvh_tree, HitRecord& rec, Ray& sample_ray, HitRecord& light_rec) = 0;
 	virtual flt pdf(const HitRecord& rec, const HitRecord& light_rec) = 0;
+	// uniform point on the surface, returns the density per unit area
+	virtual flt sampleSurface(HitRecord& light_rec) = 0;
 };
 
 
@@ -24,12 +26,16 @@ private:
 	std::vector<flt> _weight_sum;
 	flt _area;
 
+	int pick(flt ran) const;
+
 public:
 	EmissiveGroup(){}
 	EmissiveGroup(const std::vector<shared_ptr<Emissive>>& lights) { init(lights); }
 	void init(const std::vector<shared_ptr<Emissive>>& lights);
 
+	inline bool empty() const { return _lights.empty(); }
 	virtual flt getArea();
 	virtual flt sampleRay(Bvh* bvh_tree, HitRecord& rec, Ray& sample_ray, HitRecord& light_rec);
 	virtual flt pdf(const HitRecord& rec, const HitRecord& light_rec);
+	virtual flt sampleSurface(HitRecord& light_rec);
 };
\ No newline at end of file
@@ -0,0 +1,109 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "Environment.hpp"
+#include <algorithm>
+
+void EnvironmentLight::initFromXML(const tinyxml2::XMLDocument& xmlconfig, const std::string& scenepath)
+{
+	auto node = xmlconfig.FirstChildElement("environment");
+	if (!node)
+		return;
+	auto file = node->Attribute("file");
+	if (!file) {
+		ERRORM("environment has no attribute name \"file\"\n");
+	}
+	flt degrees = 0;
+	node->QueryFloatAttribute("scale", &_scale);
+	node->QueryFloatAttribute("rotate", &degrees);
+	_rotation = degrees_to_radians(degrees);
+
+	std::string path = scenepath + file;
+	int channel;
+	flt* data = stbi_loadf(path.c_str(), &_width, &_height, &channel, picChannel);
+	if (!data) {
+		ERRORM("Cannot load environment map %s\n", path.c_str());
+	}
+	_pixels.resize(size_t(_width) * _height);
+	for (size_t i = 0; i < _pixels.size(); i++)
+		_pixels[i] = glm::vec3(data[3 * i], data[3 * i + 1], data[3 * i + 2]) * _scale;
+	stbi_image_free(data);
+	buildDistribution();
+	INFO("Environment map %s: %d x %d\n", path.c_str(), _width, _height);
+}
+
+void EnvironmentLight::buildDistribution()
+{
+	_weight.resize(_pixels.size());
+	_conditional.resize(_pixels.size());
+	_marginal.resize(_height);
+	_total = 0;
+	double rows = 0;
+	for (int y = 0; y < _height; y++) {
+		flt sin_theta = sinf(pi * (y + 0.5f) / _height);
+		double row = 0;
+		for (int x = 0; x < _width; x++) {
+			size_t i = size_t(y) * _width + x;
+			_weight[i] = glm::max(0.0f, glm::dot(_pixels[i], glm::vec3(0.2126f, 0.7152f, 0.0722f))) * sin_theta;
+			row += _weight[i];
+			_conditional[i] = flt(row);
+		}
+		// a black row is never picked, keep its CDF valid anyway
+		for (int x = 0; x < _width; x++) {
+			size_t i = size_t(y) * _width + x;
+			_conditional[i] = row > 0 ? flt(_conditional[i] / row) : flt(x + 1) / _width;
+		}
+		_conditional[size_t(y) * _width + _width - 1] = 1;
+		rows += row;
+		_marginal[y] = flt(rows);
+	}
+	_total = rows;
+	for (int y = 0; y < _height; y++)
+		_marginal[y] = rows > 0 ? flt(_marginal[y] / rows) : flt(y + 1) / _height;
+	_marginal[_height - 1] = 1;
+}
+
+int EnvironmentLight::pixelIndex(const glm::vec3& dir, flt& sin_theta) const
+{
+	flt cos_theta = glm::clamp(dir.y, -1.0f, 1.0f);
+	sin_theta = sqrtf(1 - cos_theta * cos_theta);
+	flt phi = atan2f(dir.z, dir.x) - _rotation;
+	phi -= 2 * pi * floorf(phi / (2 * pi));
+	int x = glm::clamp(int(phi / (2 * pi) * _width), 0, _width - 1);
+	int y = glm::clamp(int(acosf(cos_theta) / pi * _height), 0, _height - 1);
+	return y * _width + x;
+}
+
+glm::vec3 EnvironmentLight::Le(const glm::vec3& dir) const
+{
+	flt sin_theta;
+	return _pixels[pixelIndex(dir, sin_theta)];
+}
+
+flt EnvironmentLight::sample(glm::vec3& dir) const
+{
+	if (_total <= 0)
+		return 0;
+	int y = int(std::lower_bound(_marginal.begin(), _marginal.end(), random_float()) - _marginal.begin());
+	y = std::min(y, _height - 1);
+	auto row = _conditional.begin() + size_t(y) * _width;
+	int x = int(std::lower_bound(row, row + _width, random_float()) - row);
+	x = std::min(x, _width - 1);
+
+	// uniform inside the pixel, so the density is constant over it
+	flt theta = pi * (y + random_float()) / _height;
+	flt phi = 2 * pi * (x + random_float()) / _width + _rotation;
+	flt sin_theta = sinf(theta);
+	dir = glm::vec3(sin_theta * cosf(phi), cosf(theta), sin_theta * sinf(phi));
+	if (sin_theta <= 0)
+		return 0;
+	return flt(_weight[size_t(y) * _width + x] / _total) * _width * _height / (2 * pi * pi * sin_theta);
+}
+
+flt EnvironmentLight::pdf(const glm::vec3& dir) const
+{
+	flt sin_theta;
+	int i = pixelIndex(dir, sin_theta);
+	if (_total <= 0 || sin_theta <= 0)
+		return 0;
+	return flt(_weight[i] / _total) * _width * _height / (2 * pi * pi * sin_theta);
+}
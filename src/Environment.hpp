@@ -0,0 +1,35 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+
+// Distant light from a latitude-longitude HDR image, y up: the rows go from
+// +y down to -y and the columns follow phi = atan2(z, x) plus the rotation.
+// Directions are drawn in proportion to the pixel luminance times the
+// sin(theta) of its row, first a row from the marginal CDF, then a column
+// from that row's conditional CDF.
+// <environment file="sky.hdr" scale="1" rotate="0"/>, rotate in degrees around y.
+class EnvironmentLight
+{
+public:
+	void initFromXML(const tinyxml2::XMLDocument& xmlconfig, const std::string& scenepath);
+	inline bool enabled() const { return !_pixels.empty(); }
+
+	glm::vec3 Le(const glm::vec3& dir) const;
+	// direction toward the environment, returns its density per solid angle
+	flt sample(glm::vec3& dir) const;
+	flt pdf(const glm::vec3& dir) const;
+
+private:
+	int _width = 0, _height = 0;
+	std::vector<glm::vec3> _pixels;
+	std::vector<flt> _weight;	// luminance * sin(theta) per pixel
+	std::vector<flt> _marginal;	// cumulative over the rows, last entry 1
+	std::vector<flt> _conditional;	// cumulative over the columns of each row, last entry 1
+	double _total = 0;
+	flt _scale = 1;
+	flt _rotation = 0;	// radians
+
+	void buildDistribution();
+	int pixelIndex(const glm::vec3& dir, flt& sin_theta) const;
+};
@@ -27,6 +27,9 @@ typedef float flt;
 typedef unsigned char uchar;
 
 #define _CRT_SECURE_NO_WARNINGS
+#ifndef _MSC_VER
+#define sscanf_s sscanf
+#endif
 #define IF_DEBUG 0
 #define ERRORM(fmt, ...)                                  \
     do {                                                  \
@@ -90,12 +93,55 @@ inline glm::vec3 spherical_to_cartesian_cos(flt cos_theta, flt cos_phi) {
     return res;
 }
 
+// Base seed of the random streams, every thread offsets it by its omp id.
+// Worker processes of a distributed render set it before the first sample.
+inline unsigned int& random_base_seed() {
+    static unsigned int seed = std::mt19937::default_seed;
+    return seed;
+}
+
+// bumped by random_seed, so threads that already drew reseed on their next draw
+inline unsigned int& random_generation() {
+    static unsigned int generation = 0;
+    return generation;
+}
+
+inline void random_seed(unsigned int seed) {
+    random_base_seed() = seed;
+    random_generation()++;
+}
+
+inline std::mt19937& random_generator() {
+    thread_local std::mt19937 generator;
+    thread_local unsigned int generation = ~0u;
+    if (generation != random_generation()) {
+        generation = random_generation();
+        generator.seed(random_base_seed() + 7919u * omp_get_thread_num());
+    }
+    return generator;
+}
+
+// Replayable source of the numbers random_float() hands out. Installing one on
+// a thread routes every sampling decision of that thread through it, which lets
+// the Metropolis integrator mutate and replay whole paths.
+class RandomStream
+{
+public:
+    virtual ~RandomStream() {}
+    virtual flt next() = 0;
+};
+
+inline RandomStream*& random_stream() {
+    thread_local RandomStream* stream = NULL;
+    return stream;
+}
+
 inline flt random_float() {
-    static std::uniform_real_distribution<flt> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    static std::function<flt()> rand_generator =
-        std::bind(distribution, generator);
-    return rand_generator();
+    RandomStream* stream = random_stream();
+    if (stream)
+        return stream->next();
+    std::uniform_real_distribution<flt> distribution(0.0, 1.0);
+    return distribution(random_generator());
 }
 
 inline flt random_range(flt min, flt max) {
@@ -119,6 +165,16 @@ inline glm::vec3 random_unit_vector() {
     return glm::vec3(r * cos(a), r * sin(a), z);
 }
 
+// cosine weighted direction around the unit normal n, pdf cos / pi
+inline glm::vec3 random_cosine_direction(const glm::vec3& n) {
+    flt r = sqrtf(random_float());
+    flt phi = 2 * pi * random_float();
+    glm::vec3 t = fabsf(n.x) > 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+    glm::vec3 u = glm::normalize(glm::cross(t, n));
+    glm::vec3 v = glm::cross(n, u);
+    return glm::normalize(r * cosf(phi) * u + r * sinf(phi) * v + sqrtf(glm::max(0.0f, 1 - r * r)) * n);
+}
+
 
 // wi woӦönormalͬ ͨļ㷴䣬ڵʱҪעⷽ
 inline glm::vec3 reflect(const glm::vec3& ray_in, const glm::vec3& normal) {
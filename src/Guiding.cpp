@@ -0,0 +1,97 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "Guiding.hpp"
+#include <algorithm>
+
+namespace {
+
+const int kGridResolution = 8;	// cells along the longest scene axis
+const int kMinSamples = 32;	// splats a cell needs before it is sampled
+const flt kUniformMix = 0.1f;	// keeps every bin samplable
+
+}
+
+void GuideField::init(const AABB& bounds)
+{
+	glm::vec3 extent = bounds.getMax() - bounds.getMin();
+	flt size = glm::max(glm::compMax(extent), 1e-6f) / kGridResolution;
+	_lo = bounds.getMin();
+	_inv_cell_size = 1 / size;
+	_updates = 0;
+	_train.assign(size_t(kCells) * kBins, 0);
+	_train_count.assign(kCells, 0);
+	_cdf.assign(size_t(kCells) * kBins, 0);
+	_valid.assign(kCells, 0);
+}
+
+int GuideField::cellIndex(const glm::vec3& p) const
+{
+	glm::ivec3 c = glm::ivec3(glm::floor((p - _lo) * _inv_cell_size));
+	unsigned int h = unsigned(c.x) * 73856093u ^ unsigned(c.y) * 19349663u ^ unsigned(c.z) * 83492791u;
+	return int(h & (kCells - 1));
+}
+
+int GuideField::bin(const glm::vec3& dir)
+{
+	flt phi = atan2f(dir.y, dir.x);
+	if (phi < 0)
+		phi += 2 * pi;
+	int t = glm::clamp(int((dir.z + 1) * 0.5f * kThetaBins), 0, kThetaBins - 1);
+	int p = glm::clamp(int(phi / (2 * pi) * kPhiBins), 0, kPhiBins - 1);
+	return t * kPhiBins + p;
+}
+
+void GuideField::splat(int cell, const glm::vec3& dir, flt value)
+{
+	if (!(value > 0) || !std::isfinite(value))
+		return;
+	flt& slot = _train[size_t(cell) * kBins + bin(dir)];
+#pragma omp atomic
+	slot += value;
+#pragma omp atomic
+	_train_count[cell]++;
+}
+
+// Rebuilds the sampling distributions from everything splatted so far.
+void GuideField::update()
+{
+#pragma omp parallel for schedule(static)
+	for (int cell = 0; cell < kCells; cell++) {
+		const flt* hist = &_train[size_t(cell) * kBins];
+		double total = 0;
+		for (int b = 0; b < kBins; b++)
+			total += hist[b];
+		_valid[cell] = _train_count[cell] >= kMinSamples && total > 0;
+		if (!_valid[cell])
+			continue;
+
+		flt* cdf = &_cdf[size_t(cell) * kBins];
+		double acc = 0;
+		for (int b = 0; b < kBins; b++) {
+			acc += (1 - kUniformMix) * hist[b] / total + kUniformMix / kBins;
+			cdf[b] = flt(acc);
+		}
+		cdf[kBins - 1] = 1;
+	}
+	_updates++;
+}
+
+glm::vec3 GuideField::sample(int cell) const
+{
+	const flt* cdf = &_cdf[size_t(cell) * kBins];
+	int b = int(std::upper_bound(cdf, cdf + kBins, random_float()) - cdf);
+	b = std::min(b, kBins - 1);
+	int t = b / kPhiBins, p = b % kPhiBins;
+	flt z = -1 + 2 * (t + random_float()) / kThetaBins;
+	flt phi = 2 * pi * (p + random_float()) / kPhiBins;
+	flt r = sqrtf(glm::max(0.0f, 1 - z * z));
+	return glm::vec3(r * cosf(phi), r * sinf(phi), z);
+}
+
+flt GuideField::pdf(int cell, const glm::vec3& dir) const
+{
+	const flt* cdf = &_cdf[size_t(cell) * kBins];
+	int b = bin(dir);
+	flt p = cdf[b] - (b > 0 ? cdf[b - 1] : 0);
+	return p * kBins / (4 * pi);
+}
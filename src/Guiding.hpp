@@ -0,0 +1,41 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "AABB.hpp"
+
+// Path guiding: a spatial hash grid whose cells hold directional histograms
+// of the indirect radiance arriving there. Paths splat what they measured
+// during the training passes, update() turns the histograms into the sampling
+// distributions, and diffuse bounces then draw part of their directions from
+// them. Directions are binned by (cos theta, phi), which keeps the bins equal
+// in solid angle.
+class GuideField
+{
+public:
+	static const int kThetaBins = 16;
+	static const int kPhiBins = 16;
+	static const int kBins = kThetaBins * kPhiBins;
+	static const int kCells = 1 << 14;	// hash slots, colliding cells share one
+
+	void init(const AABB& bounds);
+	void update();
+
+	inline bool ready() const { return _updates > 0; }
+	int cellIndex(const glm::vec3& p) const;
+	inline bool trained(int cell) const { return _valid[cell] != 0; }
+
+	static int bin(const glm::vec3& dir);
+	void splat(int cell, const glm::vec3& dir, flt value);
+	glm::vec3 sample(int cell) const;
+	flt pdf(int cell, const glm::vec3& dir) const;
+
+private:
+	glm::vec3 _lo;
+	flt _inv_cell_size = 1;
+	int _updates = 0;
+	std::vector<flt> _train;	// kCells x kBins splatted radiance / pdf
+	std::vector<int> _train_count;
+	std::vector<flt> _cdf;	// kCells x kBins, cumulative, last entry 1
+	std::vector<unsigned char> _valid;
+};
@@ -0,0 +1,54 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "Instance.hpp"
+
+void Mesh::build()
+{
+    if (_triangles.empty()) {
+        ERRORM("Instanced mesh %s has no triangles besides lights\n", _name.c_str());
+    }
+    _bvh.buildTree(_triangles);
+    _bvh.releaseBuildNodes();
+}
+
+Instance::Instance(shared_ptr<Mesh> mesh, const glm::mat4& to_world)
+    : _mesh(mesh)
+{
+    setTransform(to_world);
+}
+
+void Instance::setTransform(const glm::mat4& to_world)
+{
+    _to_world = to_world;
+    _to_object = glm::inverse(to_world);
+    _normal_matrix = glm::transpose(glm::mat3(_to_object));
+
+    AABB local = _mesh->_bvh.getBounds();
+    _box.init();
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? local.getMax().x : local.getMin().x,
+            (i & 2) ? local.getMax().y : local.getMin().y,
+            (i & 4) ? local.getMax().z : local.getMin().z);
+        _box += glm::vec3(_to_world * glm::vec4(corner, 1));
+    }
+}
+
+bool Instance::hit(const Ray& r, flt tmin, flt tmax, HitRecord& rec)
+{
+    glm::vec3 origin = glm::vec3(_to_object * glm::vec4(r.getOrigin(), 1));
+    glm::vec3 direction = glm::mat3(_to_object) * r.getDirection();
+    // object space rays are normalized again, t scales with the length of the direction
+    flt scale = glm::length(direction);
+    Ray local(origin, direction);
+    local.setCone(r.getConeWidth() * scale, r.getConeSpread());
+
+    HitRecord local_rec;
+    if (!_mesh->_bvh.hit(local, tmin * scale, tmax * scale, local_rec))
+        return false;
+
+    rec = local_rec;
+    rec._t = local_rec._t / scale;
+    rec._pos = glm::vec3(_to_world * glm::vec4(local_rec._pos, 1));
+    rec._normal = glm::normalize(_normal_matrix * local_rec._normal);
+    return true;
+}
@@ -0,0 +1,42 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Model.hpp"
+#include "BVH.hpp"
+
+// A mesh loaded once and shared by all its instances, with its own
+// bottom level BVH in object space.
+class Mesh
+{
+public:
+	std::string _name;
+	std::vector<Hittable*> _triangles;
+	std::vector<Triangle*> _lights;	// emissive triangles, baked per instance into world space
+	Bvh _bvh;
+
+	void build();
+};
+
+// Transformed reference to a Mesh. Instances are regular objects of the
+// scene BVH, which makes it the top level over all instances.
+class Instance : public Hittable
+{
+private:
+	shared_ptr<Mesh> _mesh;
+	glm::mat4 _to_world;
+	glm::mat4 _to_object;
+	glm::mat3 _normal_matrix;
+	AABB _box;
+
+public:
+	Instance(shared_ptr<Mesh> mesh, const glm::mat4& to_world);
+	void setTransform(const glm::mat4& to_world);
+
+	virtual AABB boundingbox() const { return _box; }
+	virtual bool hit(const Ray& r, flt tmin, flt tmax, HitRecord& rec);
+	virtual glm::vec3 getCenter() const { return _box.center(); }
+
+	inline const glm::mat4& getTransform() const { return _to_world; }
+	inline shared_ptr<Mesh> getMesh() const { return _mesh; }
+};
@@ -0,0 +1,149 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+// Linear BVH: objects are sorted along a 63 bit Morton curve of their centers
+// and every node splits its range at the highest bit in which the codes differ.
+// Much faster to build than construct(), at some cost in tree quality.
+#include "BVH.hpp"
+
+namespace {
+
+const int kTaskGrain = 4096;	// ranges below this size are built by one task
+
+// LSD radix sort of (code, id) pairs, 8 bits per pass. Every thread counts
+// its own chunk, so the scatter stays stable and needs no atomics. Passes over
+// digits that all codes share are skipped.
+void radixSort(std::vector<unsigned long long>& codes, std::vector<unsigned int>& ids, int num_threads)
+{
+	const int kDigits = 256;
+	int n = int(codes.size());
+	std::vector<unsigned long long> codes_tmp(n);
+	std::vector<unsigned int> ids_tmp(n);
+	std::vector<int> counts(size_t(num_threads) * kDigits);
+
+	for (int shift = 0; shift < 3 * kMortonBitsPerAxis; shift += 8) {
+		bool same_digit = true;
+#pragma omp parallel num_threads(num_threads)
+		{
+			int t = omp_get_thread_num();
+			int nt = omp_get_num_threads();
+			int begin = int(1LL * n * t / nt), end = int(1LL * n * (t + 1) / nt);
+			int* count = &counts[size_t(t) * kDigits];
+			std::fill(count, count + kDigits, 0);
+			for (int i = begin; i < end; i++)
+				count[(codes[i] >> shift) & 0xff]++;
+#pragma omp barrier
+#pragma omp single
+			{
+				int offset = 0;
+				for (int d = 0; d < kDigits; d++) {
+					for (int k = 0; k < nt; k++) {
+						int c = counts[size_t(k) * kDigits + d];
+						counts[size_t(k) * kDigits + d] = offset;
+						offset += c;
+					}
+					if (offset > 0 && offset < n)
+						same_digit = false;
+				}
+			}
+			if (!same_digit) {
+				for (int i = begin; i < end; i++) {
+					int dst = count[(codes[i] >> shift) & 0xff]++;
+					codes_tmp[dst] = codes[i];
+					ids_tmp[dst] = ids[i];
+				}
+			}
+		}
+		if (!same_digit) {
+			codes.swap(codes_tmp);
+			ids.swap(ids_tmp);
+		}
+	}
+}
+
+// highest set bit of x below the one of y
+inline bool lowerMsb(unsigned long long x, unsigned long long y)
+{
+	return x < y && x < (x ^ y);
+}
+
+// last index of the left half of [first, last]: the last code that still shares
+// the bit in which the first and last codes differ with the first one
+inline int findSplit(const unsigned long long* codes, int first, int last)
+{
+	unsigned long long first_code = codes[first];
+	unsigned long long diff = first_code ^ codes[last];
+	if (diff == 0)
+		return (first + last) >> 1;
+
+	int split = first;
+	int step = last - first;
+	do {
+		step = (step + 1) >> 1;
+		int mid = split + step;
+		if (mid < last && lowerMsb(first_code ^ codes[mid], diff))
+			split = mid;
+	} while (step > 1);
+	return split;
+}
+
+}
+
+// Node idx covers the sorted objects [first, last]. Its children go to next
+// and next + 1, followed by the subtrees of the left and then the right child,
+// so every range knows its slots up front and subtrees can be built in parallel.
+void Bvh::constructMortonRange(const unsigned long long* codes, const unsigned int* ids,
+	int first, int last, int idx, int next)
+{
+	BvhNode& node = _nodes[idx];
+	if (first == last) {
+		node._child = int(ids[first]);
+		node._box = _objects[ids[first]]->boundingbox();
+		return;
+	}
+
+	int split = findSplit(codes, first, last);
+	int left_count = split - first + 1;
+	node._child = idx - next;
+	int left_next = next + 2;
+	int right_next = left_next + 2 * left_count - 2;
+
+	if (left_count > kTaskGrain) {
+#pragma omp task
+		constructMortonRange(codes, ids, first, split, next, left_next);
+		constructMortonRange(codes, ids, split + 1, last, next + 1, right_next);
+#pragma omp taskwait
+	}
+	else {
+		constructMortonRange(codes, ids, first, split, next, left_next);
+		constructMortonRange(codes, ids, split + 1, last, next + 1, right_next);
+	}
+
+	node._box = node.left()->_box + node.right()->_box;
+}
+
+void Bvh::constructMorton(const std::vector<Hittable*>& objects)
+{
+	_objects = objects;
+	_num = int(objects.size());
+
+	AABB centers;
+	centers.init();
+	for (Hittable* obj : objects)
+		centers += obj->getCenter();
+	glm::vec3 lo = centers.getMin();
+	glm::vec3 extent = glm::max(centers.getMax() - lo, glm::vec3(1e-20f));
+
+	std::vector<unsigned long long> codes(_num);
+	std::vector<unsigned int> ids(_num);
+#pragma omp parallel for num_threads(_threads) schedule(static)
+	for (int i = 0; i < _num; i++) {
+		codes[i] = mortonCode((objects[i]->getCenter() - lo) / extent);
+		ids[i] = unsigned(i);
+	}
+	radixSort(codes, ids, _threads);
+
+	_nodes = new BvhNode[_num * 2 - 1];
+#pragma omp parallel num_threads(_threads)
+#pragma omp single
+	constructMortonRange(codes.data(), ids.data(), 0, _num - 1, 0, 1);
+}
@@ -0,0 +1,231 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "MLT.hpp"
+#include "Scene.hpp"
+#include <algorithm>
+
+namespace {
+
+const flt kSigma = 0.01f;	// small step width in primary sample space
+const flt kLargeStepProb = 0.3f;
+const int kMinBootstrap = 100000;	// paths that estimate the image brightness, at least one per pixel
+
+inline flt luminance(const glm::vec3& c)
+{
+	return glm::dot(c, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+}
+
+MetropolisSampler::MetropolisSampler(unsigned int seed, flt sigma, flt large_step_prob)
+	: _rng(seed), _sigma(sigma), _large_step_prob(large_step_prob)
+{
+}
+
+flt MetropolisSampler::uniform()
+{
+	std::uniform_real_distribution<flt> distribution(0.0, 1.0);
+	return distribution(_rng);
+}
+
+void MetropolisSampler::startIteration()
+{
+	_iteration++;
+	_large_step = uniform() < _large_step_prob;
+	_index = 0;
+}
+
+flt MetropolisSampler::next()
+{
+	ensureReady(_index);
+	return _samples[_index++]._value;
+}
+
+void MetropolisSampler::ensureReady(size_t i)
+{
+	if (i >= _samples.size())
+		_samples.resize(i + 1);
+	PrimarySample& x = _samples[i];
+
+	// catch up on a large step that happened while this index was unused
+	if (x._last_modified < _last_large_step) {
+		x._value = uniform();
+		x._last_modified = _last_large_step;
+	}
+	x._backup = x._value;
+	x._modify_backup = x._last_modified;
+	if (_large_step) {
+		x._value = uniform();
+	}
+	else {
+		std::normal_distribution<flt> normal(0.0f, 1.0f);
+		flt sigma = _sigma * sqrtf(flt(_iteration - x._last_modified));
+		x._value += normal(_rng) * sigma;
+		x._value -= floorf(x._value);
+		if (x._value >= 1)	// -1e-9 wraps to 1 in float
+			x._value = 0;
+	}
+	x._last_modified = _iteration;
+}
+
+void MetropolisSampler::accept()
+{
+	if (_large_step)
+		_last_large_step = _iteration;
+}
+
+void MetropolisSampler::reject()
+{
+	for (PrimarySample& x : _samples) {
+		if (x._last_modified == _iteration) {
+			x._value = x._backup;
+			x._last_modified = x._modify_backup;
+		}
+	}
+	_iteration--;
+}
+
+// The first two numbers pick the pixel, Scene::Li consumes the rest.
+glm::vec3 MetropolisRender::evaluate(Scene& scene, MetropolisSampler& sampler, int maxdepth, int& x, int& y)
+{
+	int w = scene.cam.getWidth(), h = scene.cam.getHeight();
+	random_stream() = &sampler;
+	x = glm::min(int(random_float() * w), w - 1);
+	y = glm::min(int(random_float() * h), h - 1);
+	Ray ray = scene.cam.genRayRandom(x, y);
+	glm::vec3 color = scene.Li(ray, scene.bvh_tree.getObjects(), maxdepth);
+	random_stream() = NULL;
+	if (!std::isfinite(color[0]) || !std::isfinite(color[1]) || !std::isfinite(color[2])) {
+		STAT_INC(STAT_NONFINITE);
+		return glm::vec3(0.0f);
+	}
+	return glm::max(color, glm::vec3(0.0f));
+}
+
+void MetropolisRender::clear()
+{
+	_chains.clear();
+	_splats.clear();
+	_brightness = 0;
+	_bootstrapped = false;
+	_mutations = 0;
+	_accepted = 0;
+}
+
+void MetropolisRender::bootstrap(Scene& scene, int maxdepth)
+{
+	int w = scene.cam.getWidth(), h = scene.cam.getHeight();
+	int threads = scene.settings._threads;
+	unsigned int seed = random_base_seed();
+	_bootstrapped = true;
+
+	// independent paths, each replayable from its index
+	Timer timer;
+	timer.start();
+	int num_bootstrap = std::max(kMinBootstrap, w * h);
+	std::vector<double> cdf(num_bootstrap);
+#pragma omp parallel num_threads(threads)
+	{
+		STAT_BUSY_SCOPE();
+#pragma omp for schedule(dynamic, 64) nowait
+		for (int i = 0; i < num_bootstrap; i++) {
+			MetropolisSampler sampler(seed + unsigned(i), kSigma, kLargeStepProb);
+			int x, y;
+			cdf[i] = luminance(evaluate(scene, sampler, maxdepth, x, y));
+		}
+	}
+	for (int i = 1; i < num_bootstrap; i++)
+		cdf[i] += cdf[i - 1];
+	_brightness = num_bootstrap > 0 ? cdf.back() / num_bootstrap : 0;
+	if (_brightness <= 0) {
+		INFO("MLT: no bootstrap path carries light, the image stays black\n");
+		return;
+	}
+
+	int num_chains = std::max(1, std::min(scene.settings._mlt_chains, w * h));
+	std::vector<unsigned int> chain_seeds(num_chains);
+	_chains.reserve(num_chains);
+	for (int c = 0; c < num_chains; c++) {
+		std::mt19937 pick(seed ^ (0x9e3779b9u * unsigned(c + 1)));
+		double u = std::uniform_real_distribution<double>(0.0, cdf.back())(pick);
+		int start = int(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+		_chains.emplace_back(seed + unsigned(std::min(start, num_bootstrap - 1)), kSigma, kLargeStepProb);
+		chain_seeds[c] = pick();
+	}
+	// replay the chosen bootstrap paths as the initial states, then let chains
+	// that start from the same path mutate differently
+#pragma omp parallel num_threads(threads)
+	{
+		STAT_BUSY_SCOPE();
+#pragma omp for schedule(dynamic, 1) nowait
+		for (int c = 0; c < num_chains; c++) {
+			MetropolisChain& chain = _chains[c];
+			chain._current = evaluate(scene, chain._sampler, maxdepth, chain._x, chain._y);
+			chain._current_y = luminance(chain._current);
+			chain._sampler.reseed(chain_seeds[c]);
+		}
+	}
+	_splats.assign(threads, Buffer(w, h));
+	timer.end();
+	timer.printTimeCost("MLT Bootstrap");
+	INFO("MLT: %d bootstrap paths, %d chains, brightness %.4f\n", num_bootstrap, num_chains, _brightness);
+}
+
+void MetropolisRender::renderPass(Scene& scene, int maxdepth)
+{
+	if (!_bootstrapped)
+		bootstrap(scene, maxdepth);
+	if (_chains.empty())
+		return;
+
+	long long pixels = 1LL * scene.cam.getWidth() * scene.cam.getHeight();
+	int num_chains = int(_chains.size());
+	long long accepted = 0;
+#pragma omp parallel num_threads(scene.settings._threads) reduction(+:accepted)
+	{
+		STAT_BUSY_SCOPE();
+#pragma omp for schedule(dynamic, 1) nowait
+		for (int c = 0; c < num_chains; c++) {
+			MetropolisChain& chain = _chains[c];
+			Buffer& out = _splats[omp_get_thread_num()];
+			long long count = pixels * (c + 1) / num_chains - pixels * c / num_chains;
+			for (long long m = 0; m < count; m++) {
+				chain._sampler.startIteration();
+				int x, y;
+				glm::vec3 proposed = evaluate(scene, chain._sampler, maxdepth, x, y);
+				flt proposed_y = luminance(proposed);
+				flt a = chain._current_y > 0 ? glm::min(1.0f, proposed_y / chain._current_y) : 1.0f;
+
+				// both states get their expected share of the sample
+				if (a > 0 && proposed_y > 0)
+					out.addColor(x, y, proposed * flt(_brightness * a / proposed_y));
+				if (a < 1 && chain._current_y > 0)
+					out.addColor(chain._x, chain._y, chain._current * flt(_brightness * (1 - a) / chain._current_y));
+
+				if (chain._sampler.uniform() < a) {
+					chain._current = proposed;
+					chain._current_y = proposed_y;
+					chain._x = x;
+					chain._y = y;
+					chain._sampler.accept();
+					accepted++;
+				}
+				else
+					chain._sampler.reject();
+			}
+		}
+	}
+	for (Buffer& part : _splats) {
+		scene.buf.accumulate(part);
+		part.clear();
+	}
+	_mutations += pixels;
+	_accepted += accepted;
+}
+
+void MetropolisRender::printStats() const
+{
+	if (_mutations == 0)
+		return;
+	INFO("MLT: %lld mutations, %.1f%% accepted\n", _mutations, 100.0 * _accepted / _mutations);
+}
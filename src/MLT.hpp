@@ -0,0 +1,84 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Buffer.hpp"
+
+class Scene;
+
+// One primary sample: the value random_float() returns at its index, and the
+// state to restore when a mutation is rejected.
+class PrimarySample
+{
+public:
+	flt _value = 0;
+	flt _backup = 0;
+	long long _last_modified = 0;
+	long long _modify_backup = 0;
+};
+
+// Primary sample space of one Markov chain (Kelemen et al.). The numbers are
+// created on demand by index. A large step redraws all of them, a small step
+// moves each by a normal offset whose width grows with the iterations since
+// it was last touched.
+class MetropolisSampler : public RandomStream
+{
+public:
+	MetropolisSampler(unsigned int seed, flt sigma, flt large_step_prob);
+
+	virtual flt next();
+	void startIteration();
+	void accept();
+	void reject();
+	// random numbers of the chain itself, never part of the path
+	flt uniform();
+	inline void reseed(unsigned int seed) { _rng.seed(seed); }
+
+private:
+	std::mt19937 _rng;
+	flt _sigma;
+	flt _large_step_prob;
+	long long _iteration = 0;
+	long long _last_large_step = 0;
+	bool _large_step = true;
+	std::vector<PrimarySample> _samples;
+	size_t _index = 0;
+
+	void ensureReady(size_t i);
+};
+
+// State of one Markov chain.
+class MetropolisChain
+{
+public:
+	MetropolisSampler _sampler;
+	glm::vec3 _current;
+	flt _current_y = 0;	// luminance of _current, the target density
+	int _x = 0, _y = 0;
+
+	MetropolisChain(unsigned int seed, flt sigma, flt large_step_prob) : _sampler(seed, sigma, large_step_prob) {}
+};
+
+// Primary sample space Metropolis light transport on top of Scene::Li. The
+// first pass traces a bootstrap set of independent paths, which estimates the
+// image brightness and picks where the chains start. Every pass then advances
+// the chains, in parallel, by one mutation per pixel in total and adds their
+// splats to the scene buffer, so a pass stands in for one sample per pixel.
+class MetropolisRender
+{
+public:
+	void clear();
+	void renderPass(Scene& scene, int maxdepth);
+	void printStats() const;
+
+private:
+	std::vector<MetropolisChain> _chains;
+	std::vector<Buffer> _splats;	// one per thread
+	double _brightness = 0;
+	bool _bootstrapped = false;
+	long long _mutations = 0;
+	long long _accepted = 0;
+
+	void bootstrap(Scene& scene, int maxdepth);
+	static glm::vec3 evaluate(Scene& scene, MetropolisSampler& sampler, int maxdepth, int& x, int& y);
+};
@@ -97,19 +97,22 @@ glm::vec3 HemisphereSample(const glm::vec3& N) {
 	r1 = random_float();
 	r2 = random_float();
 	r1 = r1 * 2 * pi;
-	r2s = sqrt(r2);
-	glm::vec3 ans = glm::normalize(u * cos(r1) * r2s + v * sin(r1) * r2s + w * sqrt(1 - r2));
+	r2s = glm::sqrt(r2);
+	glm::vec3 ans = glm::normalize(u * glm::cos(r1) * r2s + v * glm::sin(r1) * r2s + w * glm::sqrt(1 - r2));
 	//std::cout << ans << std::endl;
 	return ans;
 }
 
-flt PhongMaterial::scatterUniform(glm::vec3& wi, const glm::vec3 normal, const glm::vec3 wo)
+void Material::prepare()
 {
-	wi = HemisphereSample(normal);
-	return 1.0 / 2.0 / pi;
+	flt max_kd = glm::compMax(_kd);
+	_diffuse_weight = max_kd / (max_kd + log10f(_ns));
+	_spec_pdf_scale = (_ns + 1) * flt(0.5) / pi;
+	_spec_bsdf_scale = flt(0.125) * (_ns + 2);
+	_f0 = powf((1 - _ni) / (1 + _ni), 2);
 }
 
-flt PhongMaterial::scatterLambertian(glm::vec3& wi, const glm::vec3 normal)
+flt Material::scatterLambertian(glm::vec3& wi, const glm::vec3 normal) const
 {
 	flt cos_theta = sqrtf(random_float());
 	flt cos_phi = glm::cos(2 * pi * random_float());
@@ -122,7 +125,7 @@ flt PhongMaterial::scatterLambertian(glm::vec3& wi, const glm::vec3 normal)
 	return pdf;
 }
 
-flt PhongMaterial::scatterSpecular(glm::vec3& wi, const glm::vec3 normal, const glm::vec3 wo)
+flt Material::scatterSpecular(glm::vec3& wi, const glm::vec3 normal, const glm::vec3 wo) const
 {
 	glm::vec3 refle = reflect(-wo, normal);
 	flt cos_theta = pow(random_float(),(1.0/(_ns+1)));
@@ -135,32 +138,26 @@ flt PhongMaterial::scatterSpecular(glm::vec3& wi, const glm::vec3 normal, const
 	return pdf;
 }
 
-flt PhongMaterial::pdfLambertian(const glm::vec3 wi, const glm::vec3 normal)
+flt Material::pdfLambertian(const glm::vec3 wi, const glm::vec3 normal) const
 {
 	flt cos = glm::max(flt(0.0), glm::dot(wi, normal));
 	return cos / pi;
 }
 
-flt PhongMaterial::pdfSpecular(const glm::vec3 wi, const glm::vec3 normal, const glm::vec3 wo)
+flt Material::pdfSpecular(const glm::vec3 wi, const glm::vec3 normal, const glm::vec3 wo) const
 {
 	flt cos = glm::max(flt(0.0), glm::dot(reflect(-wi, normal), wo));
-	flt res = (_ns + 1) * flt(0.5) / pi * glm::pow(cos, _ns);
+	flt res = _spec_pdf_scale * glm::pow(cos, _ns);
 	return res;
 }
 
-flt PhongMaterial::scatter(Ray& ray, HitRecord& rec, Ray& scattered)
+flt Material::scatterPhong(const Ray& ray, HitRecord& rec, Ray& scattered) const
 {
 	scattered.setOrigin(rec._pos);
 	glm::vec3 wi;
 	glm::vec3 wo = -ray.getDirection();
 
-	//flt pdf = scatterUniform(wi, rec.normal, ray.getDirection());
-	//scattered.setDirection(wi);
-	//return pdf;
-
-	flt ks_weight = log10(_ns);
-
-	flt weight = glm::compMax(_kd) / (glm::compMax(_kd) + ks_weight);
+	flt weight = _diffuse_weight;
 
 	flt ran = random_float();
 	flt pdf_lambertian = 0;
@@ -182,58 +179,38 @@ flt PhongMaterial::scatter(Ray& ray, HitRecord& rec, Ray& scattered)
 	return weight * pdf_lambertian + (1 - weight) * pdf_specular;
 }
 
-glm::vec3 PhongMaterial::bsdf(glm::vec3& wi, HitRecord& rec, glm::vec3& wo)
+glm::vec3 Material::bsdfPhong(const glm::vec3& wi, HitRecord& rec, const glm::vec3& wo) const
 {
-	//return rec.mat->kd;
-	glm::vec3 kd = rec._mat->_kd;
-	
-	if (rec._mat->_has_texture)
-	{
-		kd = rec._mat->_texture.at(rec._uv);
-	}
-	glm::vec3 ks = rec._mat->_ks;
-	flt ns = rec._mat->_ns;
-	glm::vec3 wr = reflect(glm::normalize(-wi), rec._normal);
-	flt cos = glm::dot(glm::normalize(wr), wo);
-	//glm::vec3 res = kd + ks * (ns + 2) * glm::pow(cos, ns) * flt(0.5);
+	glm::vec3 kd = _has_texture ? _texture->sample(rec._uv, rec._lod) : _kd;
 	glm::vec3 half = glm::normalize(wi + wo);
-	glm::vec3 res = kd + 0.125f * ks * (ns + 2) * powf(glm::dot(half, rec._normal), ns);
+	glm::vec3 res = kd + _ks * _spec_bsdf_scale * powf(glm::dot(half, rec._normal), _ns);
 	res /= pi;
 	return res;
 }
 
-flt PhongMaterial::pdf(const glm::vec3 wi, const HitRecord rec, const glm::vec3 wo)
+flt Material::pdfPhong(const glm::vec3& wi, const HitRecord& rec, const glm::vec3& wo) const
 {
 	flt pdfKd = pdfLambertian(wi, rec._normal);
 	flt pdfKs = pdfSpecular(wi, rec._normal, wo);
-
-	flt maxKd = glm::compMax(rec._mat->_kd);
-	flt maxKs = glm::compMax(rec._mat->_ks);
-	flt ks_weight = log10(_ns);
-	flt weightKd = maxKd / (maxKd + ks_weight);
-
-	flt res = weightKd * pdfKd + (1 - weightKd) * pdfKs;
-	return res;
+	return _diffuse_weight * pdfKd + (1 - _diffuse_weight) * pdfKs;
 }
 
-flt fresnelSchlick(const flt ior1, const flt ior2, const flt cos)
+flt fresnelSchlick(const flt f0, const flt cos)
 {
-	flt f0 = powf((ior1 - ior2) / (ior1 + ior2), 2);
 	flt fresnel = f0 + (1 - f0) * powf(1 - cos, 5);
 	return fresnel;
 }
 
 // ray -> rec -> scattered
-flt GlassMaterial::scatter(Ray& ray, HitRecord& rec, Ray& scattered)
+flt Material::scatterGlass(const Ray& ray, HitRecord& rec, Ray& scattered) const
 {	
 	scattered.setOrigin(rec._pos);	
 	flt cos_theta = glm::dot(ray.getDirection(), rec._normal);
+	flt fresnel = fresnelSchlick(_f0, fabs(cos_theta));
 
 	// ray enter glass
 	if (cos_theta < 0)
 	{
-		flt fresnel = fresnelSchlick(1.0, rec._mat->_ni, fabs(cos_theta));
-
 		flt ran = random_float();
 		if (ran < fresnel)
 		{
@@ -243,7 +220,7 @@ flt GlassMaterial::scatter(Ray& ray, HitRecord& rec, Ray& scattered)
 		}
 		else
 		{
-			glm::vec3 refra = refract(ray.getDirection(), rec._normal, 1.0, rec._mat->_ni);
+			glm::vec3 refra = refract(ray.getDirection(), rec._normal, 1.0, _ni);
 			scattered.setDirection(refra);
 			return (1 - fresnel);
 		}
@@ -251,24 +228,38 @@ flt GlassMaterial::scatter(Ray& ray, HitRecord& rec, Ray& scattered)
 	// ray left glass
 	else
 	{
-		flt fresnel = fresnelSchlick(rec._mat->_ni, 1.0, fabs(cos_theta));
-		flt ran = random_float();
-		//if (ran < fresnel)
-		//{
-		//	glm::vec3 refle = reflect(ray.getDirection(), rec._normal);
-		//	scattered.setDirection(refle);
-		//	return fresnel;
-		//}
-		//else
-		//{
-			glm::vec3 refra = refract(ray.getDirection(), rec._normal, rec._mat->_ni, 1.0);
-			scattered.setDirection(refra);
-			return 1 - fresnel;
-		//}
+		random_float();	// keeps the random sequence of the reflection branch above
+		glm::vec3 refra = refract(ray.getDirection(), rec._normal, _ni, 1.0);
+		scattered.setDirection(refra);
+		return 1 - fresnel;
 	}
 }
 
-glm::vec3 GlassMaterial::bsdf(glm::vec3& wi, HitRecord& rec, glm::vec3& wo)
+// scatterGlass run backwards. Camera rays meet the Fresnel split where they
+// enter the glass and always refract where they leave, so a photon entering
+// reflects as often as a camera ray would but refracts with weight 1 / (1 - F),
+// and a photon leaving carries the 1 - F of the camera ray coming in there.
+glm::vec3 Material::scatterGlassPhoton(const Ray& ray, HitRecord& rec, Ray& scattered) const
+{
+	scattered.setOrigin(rec._pos);
+	flt cos_theta = glm::dot(ray.getDirection(), rec._normal);
+	if (cos_theta < 0)
+	{
+		flt fresnel = fresnelSchlick(_f0, fabs(cos_theta));
+		if (random_float() < fresnel)
+		{
+			scattered.setDirection(reflect(ray.getDirection(), rec._normal));
+			return glm::vec3(1.0);
+		}
+		scattered.setDirection(refract(ray.getDirection(), rec._normal, 1.0, _ni));
+		return _tr / (1 - fresnel);
+	}
+	glm::vec3 refra = refract(ray.getDirection(), rec._normal, _ni, 1.0);
+	scattered.setDirection(refra);
+	return _tr * (1 - fresnelSchlick(_f0, fabs(glm::dot(refra, rec._normal))));
+}
+
+glm::vec3 Material::bsdfGlass(const glm::vec3& wi, HitRecord& rec, const glm::vec3& wo) const
 {
 	flt flag = glm::dot(wi, rec._normal) * glm::dot(wo, rec._normal);
 	if (flag > 0)
@@ -277,11 +268,63 @@ glm::vec3 GlassMaterial::bsdf(glm::vec3& wi, HitRecord& rec, glm::vec3& wo)
 	}
 	else
 	{
-		return rec._mat->_tr;
+		return _tr;
 	}
 }
 
-flt GlassMaterial::pdf(const glm::vec3 wi, const HitRecord rec, const glm::vec3 wo)
+int ShadingBatch::add(const glm::vec3& wi, HitRecord& rec, const glm::vec3& wo)
 {
-	return 1.0;
+	int i = _count++;
+	const Material* mat = rec._mat;
+	glm::vec3 kd = mat->_has_texture ? mat->_texture->sample(rec._uv, rec._lod) : mat->_kd;
+	for (int a = 0; a < 3; a++) {
+		_wi[a][i] = wi[a];
+		_wo[a][i] = wo[a];
+		_n[a][i] = rec._normal[a];
+		_kd[a][i] = kd[a];
+		_ks[a][i] = mat->_ks[a];
+		_tr[a][i] = mat->_tr[a];
+	}
+	_ns[i] = mat->_ns;
+	_diffuse_weight[i] = mat->_diffuse_weight;
+	_spec_pdf_scale[i] = mat->_spec_pdf_scale;
+	_spec_bsdf_scale[i] = mat->_spec_bsdf_scale;
+	_glass[i] = mat->_type == GLASS ? 1.0f : 0.0f;
+	return i;
+}
+
+// Same lobes as Material::bsdfPhong/pdfPhong and Material::bsdfGlass, with the
+// cosines clamped to zero so no lane can produce a NaN.
+void ShadingBatch::eval()
+{
+	const flt inv_pi = 1 / pi;
+#pragma omp simd
+	for (int i = 0; i < _count; i++) {
+		flt cos_i = _wi[0][i] * _n[0][i] + _wi[1][i] * _n[1][i] + _wi[2][i] * _n[2][i];
+		flt cos_o = _wo[0][i] * _n[0][i] + _wo[1][i] * _n[1][i] + _wo[2][i] * _n[2][i];
+
+		// Blinn-Phong bsdf
+		flt hx = _wi[0][i] + _wo[0][i], hy = _wi[1][i] + _wo[1][i], hz = _wi[2][i] + _wo[2][i];
+		flt h_len = sqrtf(hx * hx + hy * hy + hz * hz);
+		flt cos_h = h_len > 0 ? (hx * _n[0][i] + hy * _n[1][i] + hz * _n[2][i]) / h_len : 0;
+		flt spec = powf(glm::max(cos_h, 0.0f), _ns[i]) * _spec_bsdf_scale[i];
+
+		// pdf of the mixture: cosine lobe and Phong lobe around the mirrored wi
+		flt rx = 2 * cos_i * _n[0][i] - _wi[0][i];
+		flt ry = 2 * cos_i * _n[1][i] - _wi[1][i];
+		flt rz = 2 * cos_i * _n[2][i] - _wi[2][i];
+		flt cos_r = rx * _wo[0][i] + ry * _wo[1][i] + rz * _wo[2][i];
+		flt w = _diffuse_weight[i];
+		flt phong_pdf = w * glm::max(cos_i, 0.0f) * inv_pi
+			+ (1 - w) * _spec_pdf_scale[i] * powf(glm::max(cos_r, 0.0f), _ns[i]);
+
+		bool glass = _glass[i] > 0;
+		bool same_side = cos_i * cos_o > 0;
+		for (int a = 0; a < 3; a++) {
+			flt phong = (_kd[a][i] + _ks[a][i] * spec) * inv_pi;
+			flt dielectric = same_side ? 1.0f : _tr[a][i];
+			_f[a][i] = glass ? dielectric : phong;
+		}
+		_pdf[i] = glass ? 1.0f : phong_pdf;
+	}
 }
@@ -5,44 +5,17 @@
 #include "Global.hpp"
 #include "Model.hpp"
 #include "Ray.hpp"
+#include "Texture.hpp"
 
-class Texture {
-private:
-    int _width, _height;
-    flt* _data;
-
-public:
-    Texture() {};
-    inline glm::vec3 at(int x, int y) const {
-        int id = picChannel * ((y % _height + _height) % _height * _width + (x % _width + _width) % _width);
-        return glm::vec3(_data[id + 0], _data[id + 1], _data[id + 2]);
-    }
-    inline glm::vec3 at(flt x, flt y) const {
-        return this->at(static_cast<int>(round(x)), static_cast<int>(round(y)));
-    }
-    inline glm::vec3 at(const glm::vec2& uv) const {
-        return this->at((_width)*uv[0], (_height) * (1.0f - uv[1]));
-    }
-
-    inline int getWidth() { return _width; }
-    inline int getHeight() { return _height; }
-    inline flt* getData() { return _data; }
-
-    inline void setSize(int w, int h) { _width = w; _height = h; }
-    inline void setWidth(int w) { _width = w; }
-    inline void setHeight(int h) { _height = h; }
-    inline void setData(flt* d) { _data = d; }
-
-    ~Texture() { if (!_data) delete _data; }
-};
-
+// Plain material record, stored by value in the scene's material table and
+// referenced by pointer from triangles and hit records. The lobes are chosen by
+// a switch on _type instead of virtual calls.
 class Material
 {
 public:
     MatType _type;
-    std::string _name;
 
-    Texture _texture;
+    Texture* _texture;  // owned by the scene's TextureCache
     bool _has_texture;
 
 	glm::vec3 _kd;
@@ -53,32 +26,77 @@ public:
 	flt _ns;
 	flt _ni;
 
-public:
-    virtual flt scatter(Ray& ray, HitRecord& rec, Ray& scattered) = 0;
-    virtual glm::vec3 bsdf(glm::vec3& wi, HitRecord& rec, glm::vec3& wo) = 0;
-    virtual flt pdf(const glm::vec3 wi, const HitRecord rec, const glm::vec3 wo) = 0;
-};
-
+    // derived from the fields above by prepare()
+    flt _diffuse_weight;    // probability of sampling the diffuse lobe
+    flt _spec_pdf_scale;    // (ns + 1) / 2pi
+    flt _spec_bsdf_scale;   // (ns + 2) / 8
+    flt _f0;                // Schlick reflectance at normal incidence
 
-class PhongMaterial : public Material
-{
 private:
-    flt scatterUniform(glm::vec3& wi, const glm::vec3 normal, const glm::vec3 wo);
-    flt scatterLambertian(glm::vec3& wi, const glm::vec3 normal);
-    flt scatterSpecular(glm::vec3& wi, const glm::vec3 normal, const glm::vec3 wo);
-    flt pdfLambertian(const glm::vec3 wi, const glm::vec3 normal);
-    flt pdfSpecular(const glm::vec3 wi, const glm::vec3 normal, const glm::vec3 wo);
+    flt scatterPhong(const Ray& ray, HitRecord& rec, Ray& scattered) const;
+    glm::vec3 bsdfPhong(const glm::vec3& wi, HitRecord& rec, const glm::vec3& wo) const;
+    flt pdfPhong(const glm::vec3& wi, const HitRecord& rec, const glm::vec3& wo) const;
+    flt scatterGlass(const Ray& ray, HitRecord& rec, Ray& scattered) const;
+    glm::vec3 bsdfGlass(const glm::vec3& wi, HitRecord& rec, const glm::vec3& wo) const;
+
+    flt scatterLambertian(glm::vec3& wi, const glm::vec3 normal) const;
+    flt scatterSpecular(glm::vec3& wi, const glm::vec3 normal, const glm::vec3 wo) const;
+    flt pdfLambertian(const glm::vec3 wi, const glm::vec3 normal) const;
+    flt pdfSpecular(const glm::vec3 wi, const glm::vec3 normal, const glm::vec3 wo) const;
 
 public:
-	virtual flt scatter(Ray& ray, HitRecord& rec, Ray& scattered);
-    virtual glm::vec3 bsdf(glm::vec3& wi, HitRecord& rec, glm::vec3& wo);
-    virtual flt pdf(const glm::vec3 wi, const HitRecord rec, const glm::vec3 wo);
+    void prepare();
+    // glass crossed by a photon, returns the throughput factor
+    glm::vec3 scatterGlassPhoton(const Ray& ray, HitRecord& rec, Ray& scattered) const;
+
+    // lights and diffuse materials use the Phong lobes, glass the dielectric ones
+    inline flt scatter(const Ray& ray, HitRecord& rec, Ray& scattered) const
+    {
+        return _type == GLASS ? scatterGlass(ray, rec, scattered) : scatterPhong(ray, rec, scattered);
+    }
+    inline glm::vec3 bsdf(const glm::vec3& wi, HitRecord& rec, const glm::vec3& wo) const
+    {
+        return _type == GLASS ? bsdfGlass(wi, rec, wo) : bsdfPhong(wi, rec, wo);
+    }
+    inline flt pdf(const glm::vec3& wi, const HitRecord& rec, const glm::vec3& wo) const
+    {
+        return _type == GLASS ? 1.0f : pdfPhong(wi, rec, wo);
+    }
+    // first hit feature for the denoiser, glass and lights count as white
+    inline glm::vec3 albedo(const HitRecord& rec) const
+    {
+        if (_type != DIFFUSE)
+            return glm::vec3(1.0f);
+        glm::vec3 kd = _has_texture ? _texture->sample(rec._uv, rec._lod) : _kd;
+        return glm::min(kd + _ks, glm::vec3(1.0f));
+    }
 };
+static_assert(std::is_trivially_copyable<Material>::value, "the material table is copied around as plain data");
 
-class GlassMaterial : public Material
+// Shading points in SoA layout. The material constants are gathered per lane,
+// so eval() runs one vectorizable loop over Phong and glass lanes alike instead
+// of a virtual bsdf and pdf call per hit.
+class ShadingBatch
 {
 public:
-	virtual flt scatter(Ray& ray, HitRecord& rec, Ray& scattered);
-    virtual glm::vec3 bsdf(glm::vec3& wi, HitRecord& rec, glm::vec3& wo);
-    virtual flt pdf(const glm::vec3 wi, const HitRecord rec, const glm::vec3 wo);
-};
\ No newline at end of file
+    static const int kSize = 16;
+
+    int _count = 0;
+    flt _wi[3][kSize], _wo[3][kSize], _n[3][kSize];
+    flt _kd[3][kSize], _ks[3][kSize], _tr[3][kSize];
+    flt _ns[kSize], _diffuse_weight[kSize], _spec_pdf_scale[kSize], _spec_bsdf_scale[kSize];
+    flt _glass[kSize];
+
+    // results of eval()
+    flt _f[3][kSize];
+    flt _pdf[kSize];
+
+public:
+    inline bool full() const { return _count == kSize; }
+    inline void clear() { _count = 0; }
+    int add(const glm::vec3& wi, HitRecord& rec, const glm::vec3& wo);
+    void eval();
+
+    inline glm::vec3 bsdf(int lane) const { return glm::vec3(_f[0][lane], _f[1][lane], _f[2][lane]); }
+    inline flt pdf(int lane) const { return _pdf[lane]; }
+};
@@ -68,6 +68,7 @@ flt Triangle::sampleRay(Bvh* bvh_tree, HitRecord& rec, Ray& sample_ray, HitRecor
     Ray light_ray(rec._pos, sample_p - rec._pos);
 
 
+    STAT_INC(STAT_SHADOW_RAYS);
     bool flaghit = bvh_tree->hit(light_ray, kHitEps, FLT_MAX, light_rec);
     bool flaghitlight = glm::dot(light_rec._pos - sample_p, light_rec._pos - sample_p) < kEps;
     bool flaglightdirect = glm::dot(light_ray.getDirection(), light_rec._normal) < 0;
@@ -90,9 +91,20 @@ flt Triangle::pdf(const HitRecord& rec, const HitRecord& light_rec)
     return pdf;   
 }
 
+flt Triangle::sampleSurface(HitRecord& light_rec)
+{
+    light_rec._pos = samplePoint();
+    light_rec._normal = _normal;
+    light_rec._uv = glm::vec2(0.0f);
+    light_rec._t = 0;
+    light_rec._mat = _mat;
+    light_rec._object = this;
+    return 1 / _area;
+}
+
 glm::vec3 Triangle::samplePoint()
 {
-    flt sqrt_a = random_float();
+    flt sqrt_a = sqrtf(random_float());
     flt b = random_float();
 
     glm::vec3 point;
@@ -102,6 +114,7 @@ glm::vec3 Triangle::samplePoint()
 
 bool Triangle::hit(const Ray& r, flt tmin, flt tmax, HitRecord& rec)
 {
+    STAT_INC(STAT_TRIANGLE_TESTS);
     glm::vec3 vertex0 = _pos[0];
     glm::vec3 vertex1 = _pos[1];
     glm::vec3 vertex2 = _pos[2];
@@ -131,6 +144,7 @@ bool Triangle::hit(const Ray& r, flt tmin, flt tmax, HitRecord& rec)
         rec._t = t;
         rec._normal = _normal;
         rec._uv = _tex[0] * w + _tex[1] * u + _tex[2] * v;
+        rec._lod = _uv_density + log2f(r.coneWidthAt(t) / fabsf(glm::dot(r.getDirection(), _normal)));
         rec._mat = _mat;
         rec._object = static_cast<Triangle*>(this);
         return true;
@@ -140,6 +154,110 @@ bool Triangle::hit(const Ray& r, flt tmin, flt tmax, HitRecord& rec)
     return false;
 }
 
+// Sutherland-Hodgman: clip the triangle against the six box planes.
+AABB Triangle::clippedBox(const AABB& box) const
+{
+    glm::vec3 poly[10], next[10];
+    int n = 3;
+    for (int i = 0; i < 3; i++)
+        poly[i] = _pos[i];
+
+    for (int plane = 0; plane < 6 && n > 0; plane++) {
+        int a = plane >> 1;
+        bool upper = plane & 1;
+        flt bound = upper ? box.getMax()[a] : box.getMin()[a];
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            const glm::vec3& p = poly[i];
+            const glm::vec3& q = poly[(i + 1) % n];
+            flt dp = upper ? bound - p[a] : p[a] - bound;
+            flt dq = upper ? bound - q[a] : q[a] - bound;
+            if (dp >= 0)
+                next[m++] = p;
+            if ((dp >= 0) != (dq >= 0)) {
+                glm::vec3 x = p + (q - p) * (dp / (dp - dq));
+                x[a] = bound;
+                next[m++] = x;
+            }
+        }
+        n = m;
+        for (int i = 0; i < n; i++)
+            poly[i] = next[i];
+    }
+    if (n == 0)
+        return Hittable::clippedBox(box);
+
+    AABB res(poly[0]);
+    for (int i = 1; i < n; i++)
+        res += poly[i];
+    return res.intersection(box);
+}
+
+// World space copy, used to bake the light triangles of instanced meshes.
+Triangle* Triangle::transformed(const glm::mat4& m) const
+{
+    Triangle* tri = new Triangle();
+    tri->transformFrom(*this, m);
+    return tri;
+}
+
+void Triangle::transformFrom(const Triangle& src, const glm::mat4& m)
+{
+    _mat = src._mat;
+    _mat_id = src._mat_id;
+    _mat_name = src._mat_name;
+    if (src._has_vn) {
+        glm::mat3 nrm_mat = glm::transpose(glm::inverse(glm::mat3(m)));
+        glm::vec3 vn[3];
+        for (int i = 0; i < 3; i++)
+            vn[i] = glm::normalize(nrm_mat * src._nrm[i]);
+        setVertexNormal(vn[0], vn[1], vn[2]);
+    }
+    if (src._has_vt) {
+        glm::vec2 vt[3] = { src._tex[0], src._tex[1], src._tex[2] };
+        setVertexTexCoord(vt[0], vt[1], vt[2]);
+    }
+    _flipped = src._flipped;
+    setPositions(glm::vec3(m * glm::vec4(src._pos[0], 1)),
+        glm::vec3(m * glm::vec4(src._pos[1], 1)),
+        glm::vec3(m * glm::vec4(src._pos[2], 1)));
+    // a mirroring transform reverses the winding
+    orientToVertexNormals();
+}
+
+// Move the vertices. The face normal stays on the side of the winding it was
+// put on when the triangle was loaded, the vertex normals may be stale here.
+void Triangle::setPositions(const glm::vec3& vp1, const glm::vec3& vp2, const glm::vec3& vp3)
+{
+    _pos[0] = vp1;
+    _pos[1] = vp2;
+    _pos[2] = vp3;
+
+    _normal = glm::normalize(glm::cross(_pos[1] - _pos[0], _pos[2] - _pos[0]));
+    _area = 0.5 * fabsf(glm::length(glm::cross(_pos[1] - _pos[0], _pos[2] - _pos[0])));
+    if (_flipped) {
+        _normal = -_normal;
+    }
+    if (_has_vt) {
+        updateUvDensity();
+    }
+}
+
+// Put the face normal on the side of the vertex normals, once they match _pos.
+void Triangle::orientToVertexNormals()
+{
+    if (_has_vn && glm::dot(_nrm[0], _normal) < 0) {
+        reverseFaceNormal();
+    }
+}
+
+void Triangle::updateUvDensity()
+{
+    glm::vec2 e1 = _tex[1] - _tex[0], e2 = _tex[2] - _tex[0];
+    flt uv_area = 0.5f * fabsf(e1[0] * e2[1] - e2[0] * e1[1]);
+    _uv_density = (uv_area > 0 && _area > 0) ? 0.5f * log2f(uv_area / _area) : 0;
+}
+
 void Triangle::setVertexNormal(glm::vec3& vn1, glm::vec3& vn2, glm::vec3& vn3)
 {
     _has_vn = true;
@@ -154,6 +272,7 @@ void Triangle::setVertexTexCoord(glm::vec2& vt1, glm::vec2& vt2, glm::vec2& vt3)
     _tex[0] = vt1;
     _tex[1] = vt2;
     _tex[2] = vt3;
+    updateUvDensity();
 }
 
 
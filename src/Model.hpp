@@ -15,14 +15,18 @@ class Material;
 class Hittable
 {	
 public:	
-	shared_ptr<Material> _mat;
+	const Material* _mat = NULL;	// entry of the scene's material table, set by Scene::bindMaterials
+	int _mat_id = -1;
 	std::string _mat_name;
 	Hittable(){}
-	Hittable(shared_ptr<Material> m):_mat(m){}
+	Hittable(const Material* m):_mat(m){}
+	virtual ~Hittable() = default;
 
 	virtual AABB boundingbox() const = 0;
 	virtual bool hit(const Ray& r, const flt tmin, flt tmax, HitRecord& rec) = 0;
 	virtual glm::vec3 getCenter() const = 0;
+	// bounds of the part inside box, spatial BVH splits clip objects with it
+	virtual AABB clippedBox(const AABB& box) const { return boundingbox().intersection(box); }
 };
 
 
@@ -33,9 +37,10 @@ public:
 	glm::vec3 _pos;
 	glm::vec3 _normal;
 	glm::vec2 _uv;	
+	flt _lod = 0;	// log2 of the ray cone footprint in uv units
 	flt _t = FLT_MAX;
 	Hittable* _object;
-	shared_ptr<Material> _mat;
+	const Material* _mat = NULL;
 	bool _front_face;
 
 	inline void setFaceNormal(Ray& ray, const glm::vec3& normal) {
@@ -53,7 +58,7 @@ private:
 public:
 	Sphere() {}
 	Sphere(glm::vec3 c, double r) : center(c), radius(r) {};
-	Sphere(glm::vec3 c, double r, shared_ptr<Material> m) : Hittable(m), center(c), radius(r){};
+	Sphere(glm::vec3 c, double r, const Material* m) : Hittable(m), center(c), radius(r){};
 	
 	AABB boundingbox() const;
 	virtual bool hit(Ray& r, flt tmin, flt tmax, HitRecord& rec);
@@ -69,10 +74,14 @@ private:
 	glm::vec3 _nrm[3];
 	glm::vec3 _normal;
 	flt _area;
+	flt _uv_density = 0;	// 0.5 * log2(uv area / world area)
 	bool _has_vn = false;
 	bool _has_vt = false;
+	bool _flipped = false;	// _normal points against the winding of _pos
 	glm::vec3 _pos[3];
 
+	void updateUvDensity();
+
 public:
 	Triangle() {}
 	Triangle(glm::vec3& vp1, glm::vec3& vp2, glm::vec3& vp3);
@@ -80,17 +89,23 @@ public:
 	virtual AABB boundingbox() const;
 	virtual bool hit(const Ray& r, flt tmin, flt tmax, HitRecord& rec);
 	virtual glm::vec3 getCenter()const { return (_pos[0] + _pos[1] + _pos[2]) / flt(3); }
+	virtual AABB clippedBox(const AABB& box) const;
 
 	virtual flt getArea() { return _area; }	
 	virtual flt sampleRay(Bvh* bvh_tree, HitRecord& rec, Ray& sample_ray, HitRecord& light_rec);
 	virtual flt pdf(const HitRecord& rec, const HitRecord& light_rec);
+	virtual flt sampleSurface(HitRecord& light_rec);
 	
 	glm::vec3 samplePoint();
+	Triangle* transformed(const glm::mat4& m) const;
+	void transformFrom(const Triangle& src, const glm::mat4& m);
+	void setPositions(const glm::vec3& vp1, const glm::vec3& vp2, const glm::vec3& vp3);
 	void setVertexNormal(glm::vec3& vn1, glm::vec3& vn2, glm::vec3& vn3);
 	void setVertexTexCoord(glm::vec2& vt1, glm::vec2& vt2, glm::vec2& vt3);
+	void orientToVertexNormals();
 
 	inline glm::vec3 getFaceNormal() { return _normal; }
-	inline void reverseFaceNormal() { _normal = -_normal; }	
+	inline void reverseFaceNormal() { _normal = -_normal; _flipped = !_flipped; }	
 	inline bool hasVt() { return _has_vt; }
 	inline bool hasVn() { return _has_vn; }
 };
@@ -0,0 +1,142 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "PhotonMap.hpp"
+#include "Material.hpp"
+#include <algorithm>
+
+void CausticMap::clear()
+{
+	_photons.clear();
+	_cell_start.clear();
+	_mask = 0;
+	_emitted = 0;
+}
+
+glm::ivec3 CausticMap::cell(const glm::vec3& p) const
+{
+	return glm::ivec3(glm::floor(p * _inv_cell_size));
+}
+
+unsigned int CausticMap::slot(const glm::ivec3& c) const
+{
+	unsigned int h = unsigned(c.x) * 73856093u ^ unsigned(c.y) * 19349663u ^ unsigned(c.z) * 83492791u;
+	return h & _mask;
+}
+
+void CausticMap::build(Bvh& bvh, EmissiveGroup& lights, const Material& default_mat,
+	long long count, flt radius, int maxdepth, int threads)
+{
+	clear();
+	_radius = radius;
+	_inv_cell_size = 1 / (2 * radius);
+	_emitted = count;
+
+	// every photon carries Le * area * pi / count: cosine emission from a uniform point
+	std::vector<std::vector<Photon>> local(threads);
+#pragma omp parallel num_threads(threads)
+	{
+		std::vector<Photon>& stored = local[omp_get_thread_num()];
+#pragma omp for schedule(dynamic, 1024)
+		for (long long i = 0; i < count; i++) {
+			HitRecord light_rec;
+			flt pdf_pos = lights.sampleSurface(light_rec);
+			if (pdf_pos <= 0 || !light_rec._mat)
+				continue;
+			glm::vec3 power = light_rec._mat->_ke * (pi / (pdf_pos * count));
+			Ray ray(light_rec._pos, random_cosine_direction(light_rec._normal));
+
+			bool through_glass = false;
+			for (int bounce = 0; bounce < maxdepth; bounce++) {
+				HitRecord rec;
+				if (!bvh.hit(ray, kHitEps, INFINITY, rec))
+					break;
+				const Material* mat = rec._mat ? rec._mat : &default_mat;
+				if (mat->_type == GLASS) {
+					Ray scattered;
+					power *= mat->scatterGlassPhoton(ray, rec, scattered);
+					ray = scattered;
+					through_glass = true;
+					continue;
+				}
+				if (mat->_type == DIFFUSE && through_glass)
+					stored.push_back(Photon{ rec._pos, -ray.getDirection(), power });
+				break;
+			}
+		}
+	}
+
+	size_t total = 0;
+	for (const auto& stored : local)
+		total += stored.size();
+	if (total == 0)
+		return;
+
+	unsigned int slots = 1;
+	while (slots < 2 * total)
+		slots <<= 1;
+	_mask = slots - 1;
+
+	// counting sort by slot
+	std::vector<Photon> all;
+	all.reserve(total);
+	for (auto& stored : local) {
+		all.insert(all.end(), stored.begin(), stored.end());
+		std::vector<Photon>().swap(stored);
+	}
+	std::vector<unsigned int> keys(total);
+#pragma omp parallel for num_threads(threads) schedule(static)
+	for (long long i = 0; i < (long long)total; i++)
+		keys[i] = slot(cell(all[i]._pos));
+	_cell_start.assign(size_t(slots) + 1, 0);
+	for (size_t i = 0; i < total; i++)
+		_cell_start[keys[i] + 1]++;
+	for (unsigned int s = 0; s < slots; s++)
+		_cell_start[s + 1] += _cell_start[s];
+	std::vector<size_t> next(_cell_start.begin(), _cell_start.end() - 1);
+	_photons.resize(total);
+	for (size_t i = 0; i < total; i++)
+		_photons[next[keys[i]]++] = all[i];
+}
+
+glm::vec3 CausticMap::gather(HitRecord& rec, const glm::vec3& wo)
+{
+	STAT_INC(STAT_CAUSTIC_GATHERS);
+	glm::vec3 sum(0.0f);
+	flt r2 = _radius * _radius;
+	// the query box spans 2 cells per axis: this one and the neighbor on the
+	// side of the nearer half. Colliding cells share a slot.
+	glm::vec3 g = rec._pos * _inv_cell_size;
+	glm::vec3 f = g - glm::floor(g);
+	glm::ivec3 lo = cell(rec._pos) - glm::ivec3(glm::lessThan(f, glm::vec3(0.5f)));
+	unsigned int visited[8];
+	int num_visited = 0;
+	for (int z = lo.z; z <= lo.z + 1; z++) {
+		for (int y = lo.y; y <= lo.y + 1; y++) {
+			for (int x = lo.x; x <= lo.x + 1; x++) {
+				unsigned int s = slot(glm::ivec3(x, y, z));
+				if (std::find(visited, visited + num_visited, s) != visited + num_visited)
+					continue;
+				visited[num_visited++] = s;
+				for (size_t i = _cell_start[s]; i < _cell_start[s + 1]; i++) {
+					const Photon& photon = _photons[i];
+					glm::vec3 d = photon._pos - rec._pos;
+					if (glm::dot(d, d) > r2 || glm::dot(photon._wi, rec._normal) <= 0)
+						continue;
+					sum += rec._mat->bsdf(photon._wi, rec, wo) * photon._power;
+				}
+			}
+		}
+	}
+	return sum / (pi * r2);
+}
+
+void CausticMap::printStats() const
+{
+	if (_emitted == 0)
+		return;
+	double mb = (_photons.size() * sizeof(Photon) + _cell_start.size() * sizeof(size_t)) / (1024.0 * 1024.0);
+	INFO("Caustics: %zu of %lld photons stored, radius %.4f, %.2f MB\n", _photons.size(), _emitted, _radius, mb);
+#ifdef ENABLE_STATS
+	INFO("  %lld gathers\n", RenderStats::total(STAT_CAUSTIC_GATHERS));
+#endif
+}
@@ -0,0 +1,45 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "BVH.hpp"
+#include "Emissive.hpp"
+
+class Material;
+
+class Photon
+{
+public:
+	glm::vec3 _pos;
+	glm::vec3 _wi;	// toward where the photon came from
+	glm::vec3 _power;
+};
+
+// Caustic photon map. Photons leave the emitters, pass through glass and are
+// stored where they first land on a diffuse surface; paths that reach a diffuse
+// surface directly are left to the path tracer. The photons are sorted by the
+// hash of their grid cell, the cells being twice the gather radius wide, so a
+// gather reads at most eight contiguous runs.
+class CausticMap
+{
+public:
+	void clear();
+	void build(Bvh& bvh, EmissiveGroup& lights, const Material& default_mat,
+		long long count, flt radius, int maxdepth, int threads);
+
+	inline bool empty() const { return _photons.empty(); }
+	// radiance reflected toward wo by the caustic photons around rec
+	glm::vec3 gather(HitRecord& rec, const glm::vec3& wo);
+	void printStats() const;
+
+private:
+	std::vector<Photon> _photons;
+	std::vector<size_t> _cell_start;	// slot s holds photons [_cell_start[s], _cell_start[s + 1])
+	unsigned int _mask = 0;
+	flt _radius = 0;
+	flt _inv_cell_size = 1;
+	long long _emitted = 0;
+
+	unsigned int slot(const glm::ivec3& c) const;
+	glm::ivec3 cell(const glm::vec3& p) const;
+};
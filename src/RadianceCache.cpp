@@ -0,0 +1,136 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "RadianceCache.hpp"
+
+namespace {
+
+const int kMaxProbes = 8;
+
+inline unsigned int fingerprint(unsigned long long k)
+{
+	return unsigned(k >> 32) | 1u;
+}
+
+}
+
+void RadianceCache::init(const AABB& bounds, int resolution, int min_samples, StatCounter stats)
+{
+	glm::vec3 extent = bounds.getMax() - bounds.getMin();
+	flt size = glm::max(glm::compMax(extent), 1e-6f) / resolution;
+	_lo = bounds.getMin();
+	_inv_cell_size = 1 / size;
+	_min_samples = min_samples;
+	std::vector<std::atomic<unsigned int>> keys(kSlots);
+	for (auto& k : keys)
+		k.store(0, std::memory_order_relaxed);
+	_keys.swap(keys);
+	_cells.assign(kSlots, Cell());
+	_stats = stats;
+}
+
+void RadianceCache::clear()
+{
+	std::vector<std::atomic<unsigned int>>().swap(_keys);
+	std::vector<Cell>().swap(_cells);
+}
+
+// 64 bit mix of the cell and the normal axis; the low bits pick the slot,
+// the high bits are the fingerprint.
+unsigned long long RadianceCache::key(const glm::vec3& p, const glm::vec3& n) const
+{
+	glm::ivec3 c = glm::ivec3(glm::floor((p - _lo) * _inv_cell_size));
+	glm::vec3 a = glm::abs(n);
+	int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+	unsigned long long side = 2 * axis + (n[axis] < 0);
+	unsigned long long k = unsigned(c.x) * 0x9E3779B97F4A7C15ull ^ unsigned(c.y) * 0xC2B2AE3D27D4EB4Full
+		^ unsigned(c.z) * 0x165667B19E3779F9ull ^ side;
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return k;
+}
+
+int RadianceCache::find(unsigned long long k) const
+{
+	unsigned int fp = fingerprint(k);
+	for (int i = 0; i < kMaxProbes; i++) {
+		int s = int((k + i) & (kSlots - 1));
+		unsigned int stored = _keys[s].load(std::memory_order_relaxed);
+		if (stored == fp)
+			return s;
+		if (stored == 0)
+			return -1;
+	}
+	return -1;
+}
+
+int RadianceCache::insert(unsigned long long k)
+{
+	unsigned int fp = fingerprint(k);
+	for (int i = 0; i < kMaxProbes; i++) {
+		int s = int((k + i) & (kSlots - 1));
+		unsigned int stored = _keys[s].load(std::memory_order_relaxed);
+		if (stored == 0 && _keys[s].compare_exchange_strong(stored, fp, std::memory_order_relaxed))
+			return s;
+		if (stored == fp)
+			return s;
+	}
+	return -1;
+}
+
+bool RadianceCache::lookup(const glm::vec3& p, const glm::vec3& n, glm::vec3& radiance)
+{
+	STAT_INC(_stats);
+	int s = find(key(p, n));
+	if (s < 0)
+		return false;
+	Cell& cell = _cells[s];
+	int count;
+	glm::vec3 sum;
+#pragma omp atomic read
+	count = cell._count;
+	if (count < _min_samples)
+		return false;
+	for (int c = 0; c < 3; c++) {
+#pragma omp atomic read
+		sum[c] = cell._sum[c];
+	}
+	radiance = sum / flt(count);
+	STAT_INC(_stats + 1);
+	return true;
+}
+
+void RadianceCache::splat(const glm::vec3& p, const glm::vec3& n, const glm::vec3& radiance)
+{
+	if (!std::isfinite(radiance[0]) || !std::isfinite(radiance[1]) || !std::isfinite(radiance[2]))
+		return;
+	int s = insert(key(p, n));
+	if (s < 0) {
+		STAT_INC(_stats + 2);
+		return;
+	}
+	Cell& cell = _cells[s];
+	for (int c = 0; c < 3; c++) {
+#pragma omp atomic
+		cell._sum[c] += radiance[c];
+	}
+#pragma omp atomic
+	cell._count++;
+}
+
+void RadianceCache::printStats(const char* name) const
+{
+	if (!enabled())
+		return;
+	int used = 0;
+	for (const auto& k : _keys)
+		used += k.load(std::memory_order_relaxed) != 0;
+	double mb = _cells.size() * (sizeof(Cell) + sizeof(unsigned int)) / (1024.0 * 1024.0);
+	INFO("%s: %d of %d slots used, %.2f MB\n", name, used, kSlots, mb);
+#ifdef ENABLE_STATS
+	INFO("  %lld of %lld lookups found a value, %lld splats dropped\n", RenderStats::total(StatCounter(_stats + 1)),
+		RenderStats::total(StatCounter(_stats)), RenderStats::total(StatCounter(_stats + 2)));
+#endif
+}
@@ -0,0 +1,49 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "AABB.hpp"
+#include "Stats.hpp"
+#include <atomic>
+
+// Outgoing radiance of diffuse surfaces, cached in a spatial hash grid keyed
+// by the cell of the position and the dominant axis of the normal. Slots are
+// claimed with a compare-and-swap on a 32 bit fingerprint of the key and
+// collisions probe linearly, so threads fill the cache while they render.
+// Lambertian surfaces reflect the same radiance in every direction, which
+// lets one value per cell stand for all view directions.
+class RadianceCache
+{
+public:
+	static const int kSlots = 1 << 19;
+
+	// resolution: cells along the longest scene axis, stats: the first of its
+	// lookup, hit and dropped splat counters
+	void init(const AABB& bounds, int resolution, int min_samples, StatCounter stats);
+	void clear();
+	inline bool enabled() const { return !_cells.empty(); }
+
+	// false until the cell has seen min_samples splats
+	bool lookup(const glm::vec3& p, const glm::vec3& n, glm::vec3& radiance);
+	void splat(const glm::vec3& p, const glm::vec3& n, const glm::vec3& radiance);
+	void printStats(const char* name) const;
+
+private:
+	class Cell
+	{
+	public:
+		glm::vec3 _sum = glm::vec3(0.0f);
+		int _count = 0;
+	};
+
+	std::vector<std::atomic<unsigned int>> _keys;	// 0 = free
+	std::vector<Cell> _cells;
+	glm::vec3 _lo;
+	flt _inv_cell_size = 1;
+	int _min_samples = 1;	// splats a cell needs before lookups use it
+	int _stats = STAT_RADIANCE_CACHE_LOOKUPS;	// lookups, hits, then splats dropped because their probe sequence was full
+
+	unsigned long long key(const glm::vec3& p, const glm::vec3& n) const;
+	int find(unsigned long long k) const;
+	int insert(unsigned long long k);
+};
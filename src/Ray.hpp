@@ -8,6 +8,9 @@ class Ray
 private:
 	glm::vec3 _origin;
 	glm::vec3 _direction;
+	// ray cone for texture LOD: footprint width at the origin and spread angle
+	flt _cone_width = 0;
+	flt _cone_spread = 0;
 
 public:
 	Ray(){}
@@ -19,4 +22,9 @@ public:
 	inline void setDirection(const glm::vec3& d) { _direction = d; }	
 	inline glm::vec3 getOrigin() const { return _origin; }
 	inline glm::vec3 getDirection() const { return _direction; }
+
+	inline void setCone(flt width, flt spread) { _cone_width = width; _cone_spread = spread; }
+	inline flt coneWidthAt(flt t) const { return _cone_width + t * _cone_spread; }
+	inline flt getConeWidth() const { return _cone_width; }
+	inline flt getConeSpread() const { return _cone_spread; }
 };
\ No newline at end of file
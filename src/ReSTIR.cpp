@@ -0,0 +1,94 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "ReSTIR.hpp"
+#include "BVH.hpp"
+#include "Material.hpp"
+
+namespace {
+
+inline flt luminance(const glm::vec3& c)
+{
+	return glm::dot(c, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+}
+
+void LightReservoir::update(const glm::vec3& pos, const glm::vec3& normal, const glm::vec3& le, flt target, double weight)
+{
+	if (!(weight > 0))
+		return;
+	_weight_sum += weight;
+	if (random_float() * _weight_sum < weight) {
+		_pos = pos;
+		_normal = normal;
+		_le = le;
+		_target = target;
+	}
+}
+
+// Le * bsdf * cos * cos / d^2, zero when either side faces away.
+glm::vec3 ResampledLights::unshadowed(HitRecord& rec, const glm::vec3& wo,
+	const glm::vec3& pos, const glm::vec3& normal, const glm::vec3& le)
+{
+	glm::vec3 d = pos - rec._pos;
+	flt dist2 = glm::dot(d, d);
+	if (dist2 <= kEps)
+		return glm::vec3(0.0f);
+	glm::vec3 wi = d / sqrtf(dist2);
+	flt cos = glm::dot(wi, rec._normal);
+	flt cos_light = -glm::dot(wi, normal);
+	if (cos <= 0 || cos_light <= 0)
+		return glm::vec3(0.0f);
+	return le * rec._mat->bsdf(wi, rec, wo) * (cos * cos_light / dist2);
+}
+
+void ResampledLights::sample(EmissiveGroup& lights, HitRecord& rec, const glm::vec3& wo, int candidates, LightReservoir& out)
+{
+	out = LightReservoir();
+	for (int i = 0; i < candidates; i++) {
+		HitRecord light_rec;
+		flt pdf = lights.sampleSurface(light_rec);
+		if (pdf <= 0 || !light_rec._mat)
+			continue;
+		flt target = luminance(unshadowed(rec, wo, light_rec._pos, light_rec._normal, light_rec._mat->_ke));
+		out.update(light_rec._pos, light_rec._normal, light_rec._mat->_ke, target, target / pdf);
+	}
+	out._m = candidates;
+	out._w = out._target > 0 ? flt(out._weight_sum / (out._m * out._target)) : 0;
+}
+
+void ResampledLights::combine(const ReservoirSite* sites, int count, LightReservoir& out)
+{
+	const ReservoirSite& here = sites[0];
+	out = LightReservoir();
+	for (int k = 0; k < count; k++) {
+		const LightReservoir& in = *sites[k]._reservoir;
+		out._m += in._m;
+		if (in._w <= 0)
+			continue;
+		flt target = luminance(unshadowed(*here._rec, here._wo, in._pos, in._normal, in._le));
+		out.update(in._pos, in._normal, in._le, target, double(target) * in._w * in._m);
+	}
+	if (out._target <= 0)
+		return;
+	int z = 0;
+	for (int k = 0; k < count; k++) {
+		const ReservoirSite& site = sites[k];
+		if (luminance(unshadowed(*site._rec, site._wo, out._pos, out._normal, out._le)) > 0)
+			z += site._reservoir->_m;
+	}
+	out._w = z > 0 ? flt(out._weight_sum / (double(z) * out._target)) : 0;
+}
+
+glm::vec3 ResampledLights::shade(Bvh& bvh, HitRecord& rec, const glm::vec3& wo, const LightReservoir& reservoir)
+{
+	if (reservoir._w <= 0)
+		return glm::vec3(0.0f);
+	glm::vec3 d = reservoir._pos - rec._pos;
+	flt dist = glm::length(d);
+	HitRecord tmp;
+	STAT_INC(STAT_SHADOW_RAYS);
+	if (bvh.hit(Ray(rec._pos, d), kHitEps, dist * (1 - 1e-4f), tmp))
+		return glm::vec3(0.0f);
+	return unshadowed(rec, wo, reservoir._pos, reservoir._normal, reservoir._le) * reservoir._w;
+}
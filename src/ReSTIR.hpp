@@ -0,0 +1,52 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Model.hpp"
+#include "Emissive.hpp"
+
+class Bvh;
+
+// Weighted reservoir holding one point on the lights. _m counts the
+// candidates it stands for, _w is the contribution weight of the kept point
+// (an estimate of 1 / its density) once the reservoir is finished.
+class LightReservoir
+{
+public:
+	glm::vec3 _pos;
+	glm::vec3 _normal;
+	glm::vec3 _le = glm::vec3(0.0f);
+	flt _target = 0;	// target density of the kept point at the shading point
+	double _weight_sum = 0;
+	int _m = 0;
+	flt _w = 0;
+
+	void update(const glm::vec3& pos, const glm::vec3& normal, const glm::vec3& le, flt target, double weight);
+};
+
+// A first hit of the wave and its reservoir, the input of spatial reuse.
+class ReservoirSite
+{
+public:
+	HitRecord* _rec;
+	glm::vec3 _wo;
+	const LightReservoir* _reservoir;
+};
+
+// Resampled importance sampling of the direct light (ReSTIR without the
+// temporal part). Many light points are drawn by area and weighted by their
+// unshadowed contribution, only the one kept pays for a shadow ray. The
+// target density is the luminance of Le * bsdf * G.
+class ResampledLights
+{
+public:
+	static void sample(EmissiveGroup& lights, HitRecord& rec, const glm::vec3& wo, int candidates, LightReservoir& out);
+	// Reservoirs of neighboring pixels, sites[0] being the one shaded. Each
+	// input is reweighted by the target at the shading point; normalizing by
+	// the candidates of the sites that could have produced the kept point
+	// keeps the result unbiased.
+	static void combine(const ReservoirSite* sites, int count, LightReservoir& out);
+	static glm::vec3 shade(Bvh& bvh, HitRecord& rec, const glm::vec3& wo, const LightReservoir& reservoir);
+	static glm::vec3 unshadowed(HitRecord& rec, const glm::vec3& wo,
+		const glm::vec3& pos, const glm::vec3& normal, const glm::vec3& le);
+};
@@ -0,0 +1,306 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+// Spatial split BVH: besides partitioning the objects, a node may split space
+// at a plane and clip the objects straddling it into two references. Large
+// triangles then no longer blow up the boxes of the small objects around them.
+#include "BVH.hpp"
+
+namespace {
+
+const int kSplitBins = 32;
+const flt kOverlapAlpha = 1e-5f;	// try spatial splits when the object split children overlap this fraction of the root
+
+class Reference
+{
+public:
+	AABB _box;
+	unsigned int _id;
+};
+
+class SplitNode
+{
+public:
+	AABB _box;
+	int _left = -1;	// right child is _left + 1, -1 for a leaf
+	unsigned int _id = 0;
+};
+
+class Split
+{
+public:
+	flt _cost = INFINITY;
+	int _axis = -1;
+	flt _pos = 0;	// object split: bin index, spatial split: plane position
+	AABB _left, _right;
+};
+
+inline AABB emptyBox()
+{
+	AABB box;
+	box.init();
+	return box;
+}
+
+inline AABB slab(const AABB& box, int axis, flt lo, flt hi)
+{
+	glm::vec3 bmin = box.getMin(), bmax = box.getMax();
+	bmin[axis] = glm::max(bmin[axis], lo);
+	bmax[axis] = glm::min(bmax[axis], hi);
+	return AABB(bmin, bmax);
+}
+
+inline flt boxArea(const AABB& box)
+{
+	return box.empty() ? 0 : box.area();
+}
+
+class SpatialSplitBuilder
+{
+public:
+	const std::vector<Hittable*>& _objects;
+	std::vector<SplitNode> _nodes;
+	size_t _num_refs;
+	size_t _max_refs;
+	flt _root_area = 0;
+
+	SpatialSplitBuilder(const std::vector<Hittable*>& objects, flt growth)
+		: _objects(objects), _num_refs(objects.size())
+	{
+		_max_refs = size_t(objects.size() * (1 + glm::max(growth, 0.0f)));
+	}
+
+	static int centroidBin(const Reference& ref, int axis, flt lo, flt extent)
+	{
+		int b = int(kSplitBins * (ref._box.center()[axis] - lo) / extent);
+		return glm::clamp(b, 0, kSplitBins - 1);
+	}
+
+	Split objectSplit(const std::vector<Reference>& refs)
+	{
+		Split best;
+		AABB centers = emptyBox();
+		for (const Reference& ref : refs)
+			centers += ref._box.center();
+
+		for (int axis = 0; axis < 3; axis++) {
+			flt lo = centers.getMin()[axis];
+			flt extent = centers.getMax()[axis] - lo;
+			if (extent <= 0)
+				continue;
+
+			AABB boxes[kSplitBins];
+			int counts[kSplitBins] = { 0 };
+			for (int b = 0; b < kSplitBins; b++)
+				boxes[b] = emptyBox();
+			for (const Reference& ref : refs) {
+				int b = centroidBin(ref, axis, lo, extent);
+				boxes[b] += ref._box;
+				counts[b]++;
+			}
+
+			AABB right[kSplitBins];
+			int right_count[kSplitBins];
+			AABB acc = emptyBox();
+			int count = 0;
+			for (int b = kSplitBins - 1; b > 0; b--) {
+				acc += boxes[b];
+				count += counts[b];
+				right[b] = acc;
+				right_count[b] = count;
+			}
+			acc = emptyBox();
+			count = 0;
+			for (int b = 1; b < kSplitBins; b++) {
+				acc += boxes[b - 1];
+				count += counts[b - 1];
+				if (count == 0 || right_count[b] == 0)
+					continue;
+				flt cost = boxArea(acc) * count + boxArea(right[b]) * right_count[b];
+				if (cost < best._cost) {
+					best._cost = cost;
+					best._axis = axis;
+					best._pos = flt(b);
+					best._left = acc;
+					best._right = right[b];
+				}
+			}
+		}
+		return best;
+	}
+
+	Split spatialSplit(const std::vector<Reference>& refs, const AABB& node_box)
+	{
+		Split best;
+		for (int axis = 0; axis < 3; axis++) {
+			flt lo = node_box.getMin()[axis];
+			flt width = (node_box.getMax()[axis] - lo) / kSplitBins;
+			if (width <= 0)
+				continue;
+
+			AABB boxes[kSplitBins];
+			int entry[kSplitBins] = { 0 }, exit[kSplitBins] = { 0 };
+			for (int b = 0; b < kSplitBins; b++)
+				boxes[b] = emptyBox();
+			for (const Reference& ref : refs) {
+				int b0 = glm::clamp(int((ref._box.getMin()[axis] - lo) / width), 0, kSplitBins - 1);
+				int b1 = glm::clamp(int((ref._box.getMax()[axis] - lo) / width), b0, kSplitBins - 1);
+				if (b0 == b1)
+					boxes[b0] += ref._box;
+				else {
+					for (int b = b0; b <= b1; b++) {
+						AABB part = slab(ref._box, axis, lo + b * width, lo + (b + 1) * width);
+						part = _objects[ref._id]->clippedBox(part);
+						if (!part.empty())
+							boxes[b] += part;
+					}
+				}
+				entry[b0]++;
+				exit[b1]++;
+			}
+
+			AABB right[kSplitBins];
+			int right_count[kSplitBins];
+			AABB acc = emptyBox();
+			int count = 0;
+			for (int b = kSplitBins - 1; b > 0; b--) {
+				acc += boxes[b];
+				count += exit[b];
+				right[b] = acc;
+				right_count[b] = count;
+			}
+			acc = emptyBox();
+			count = 0;
+			for (int b = 1; b < kSplitBins; b++) {
+				acc += boxes[b - 1];
+				count += entry[b - 1];
+				if (count == 0 || right_count[b] == 0)
+					continue;
+				flt cost = boxArea(acc) * count + boxArea(right[b]) * right_count[b];
+				if (cost < best._cost) {
+					best._cost = cost;
+					best._axis = axis;
+					best._pos = lo + b * width;
+				}
+			}
+		}
+		return best;
+	}
+
+	bool partitionSpatial(const std::vector<Reference>& refs, const Split& split,
+		std::vector<Reference>& left, std::vector<Reference>& right)
+	{
+		int axis = split._axis;
+		for (const Reference& ref : refs) {
+			if (ref._box.getMax()[axis] <= split._pos)
+				left.push_back(ref);
+			else if (ref._box.getMin()[axis] >= split._pos)
+				right.push_back(ref);
+			else {
+				Reference l = ref, r = ref;
+				l._box = _objects[ref._id]->clippedBox(slab(ref._box, axis, -INFINITY, split._pos));
+				r._box = _objects[ref._id]->clippedBox(slab(ref._box, axis, split._pos, INFINITY));
+				if (!l._box.empty())
+					left.push_back(l);
+				if (!r._box.empty())
+					right.push_back(r);
+				if (!l._box.empty() && !r._box.empty())
+					_num_refs++;
+			}
+		}
+		return !left.empty() && !right.empty() && (left.size() < refs.size() || right.size() < refs.size());
+	}
+
+	void partitionObjects(const std::vector<Reference>& refs, const Split& split,
+		std::vector<Reference>& left, std::vector<Reference>& right)
+	{
+		if (split._axis < 0) {
+			// every centroid coincides, split the list in half
+			size_t half = refs.size() / 2;
+			left.assign(refs.begin(), refs.begin() + half);
+			right.assign(refs.begin() + half, refs.end());
+			return;
+		}
+		AABB centers = emptyBox();
+		for (const Reference& ref : refs)
+			centers += ref._box.center();
+		flt lo = centers.getMin()[split._axis];
+		flt extent = centers.getMax()[split._axis] - lo;
+		for (const Reference& ref : refs) {
+			if (centroidBin(ref, split._axis, lo, extent) < int(split._pos))
+				left.push_back(ref);
+			else
+				right.push_back(ref);
+		}
+	}
+
+	void build(int idx, std::vector<Reference>& refs)
+	{
+		AABB box = emptyBox();
+		for (const Reference& ref : refs)
+			box += ref._box;
+		_nodes[idx]._box = box;
+		if (refs.size() == 1) {
+			_nodes[idx]._id = refs[0]._id;
+			return;
+		}
+
+		std::vector<Reference> left, right;
+		Split object = objectSplit(refs);
+		bool split_done = false;
+		if (_num_refs < _max_refs && object._axis >= 0
+			&& boxArea(object._left.intersection(object._right)) > kOverlapAlpha * _root_area) {
+			Split spatial = spatialSplit(refs, box);
+			if (spatial._axis >= 0 && spatial._cost < object._cost) {
+				size_t num_refs = _num_refs;
+				split_done = partitionSpatial(refs, spatial, left, right);
+				if (!split_done) {
+					left.clear();
+					right.clear();
+					_num_refs = num_refs;
+				}
+			}
+		}
+		if (!split_done)
+			partitionObjects(refs, object, left, right);
+		std::vector<Reference>().swap(refs);
+
+		int child = int(_nodes.size());
+		_nodes[idx]._left = child;
+		_nodes.emplace_back();
+		_nodes.emplace_back();
+		build(child, left);
+		build(child + 1, right);
+	}
+};
+
+}
+
+void Bvh::constructSpatial(const std::vector<Hittable*>& objects)
+{
+	_objects = objects;
+	SpatialSplitBuilder builder(objects, _split_growth);
+
+	std::vector<Reference> refs(objects.size());
+	for (size_t i = 0; i < objects.size(); i++) {
+		refs[i]._box = objects[i]->boundingbox();
+		refs[i]._id = unsigned(i);
+	}
+	AABB total = emptyBox();
+	for (const Reference& ref : refs)
+		total += ref._box;
+	builder._root_area = boxArea(total);
+
+	builder._nodes.reserve(builder._max_refs * 2);
+	builder._nodes.emplace_back();
+	builder.build(0, refs);
+
+	// same layout as construct(): children are adjacent, _child is the negative offset to the left one
+	_num = int(builder._nodes.size() + 1) / 2;
+	_nodes = new BvhNode[_num * 2 - 1];
+	for (int i = 0; i < _num * 2 - 1; i++) {
+		const SplitNode& node = builder._nodes[i];
+		_nodes[i]._box = node._box;
+		_nodes[i]._child = node._left < 0 ? int(node._id) : i - node._left;
+	}
+	INFO("Spatial split BVH: %d references for %d objects\n", _num, int(objects.size()));
+}
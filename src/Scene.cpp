@@ -2,6 +2,62 @@
 // Date:   Mar 1 2023
 
 #include "Scene.hpp"
+#include "Wavefront.hpp"
+#include "BDPT.hpp"
+#include "ReSTIR.hpp"
+
+static const int kFeatureSamples = 64;  // the first hit features converge long before the colors
+static const int kGuideTrainPasses = 64;
+static const int kMaxGuideVertices = 32;
+static const flt kGuideFraction = 0.5f; // share of the diffuse bounces drawn from the guide
+static const flt kCausticRadiusScale = 0.005f;  // default gather radius over the longest scene extent
+static const int kMaxCacheVertices = 32;
+static const flt kCacheTrainFraction = 0.25f;   // paths that never end in the radiance cache
+static const int kCacheResolution = 64;     // radiance cache cells along the longest scene axis
+static const int kCacheMinSamples = 16;
+static const flt kRouletteTrainFraction = 0.25f;    // paths that teach the roulette estimate
+static const flt kWindowWidth = 5.0f;       // upper over lower bound of the weight window
+static const flt kMinSurvival = 0.05f;
+static const int kMinEstimatePasses = 4;    // passes in the image before its pixels guide the roulette
+static const int kRouletteResolution = 32;  // the roulette only needs a rough estimate, but soon
+static const int kRouletteMinSamples = 4;
+static const int kMaxBranches = 16;         // split paths per camera sample
+
+static inline flt luminance(const glm::vec3& c)
+{
+    return glm::dot(c, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// a diffuse bounce of a training path
+class GuideVertex
+{
+public:
+    int _cell;
+    glm::vec3 _wi;
+    glm::vec3 _throughput;  // after the bounce
+    glm::vec3 _color;       // gathered before the bounce
+    flt _pdf;
+};
+
+// a diffuse hit whose outgoing radiance goes to the radiance cache
+class CacheVertex
+{
+public:
+    glm::vec3 _pos;
+    glm::vec3 _normal;
+    glm::vec3 _throughput;  // before the hit
+    glm::vec3 _color;       // gathered before the hit
+};
+
+// a split path waiting to be traced from its scattered ray
+class PathBranch
+{
+public:
+    Ray _ray;
+    glm::vec3 _throughput;
+    int _bounce;
+};
+
 Scene::Scene(std::string& scenepath, std::string& scenename, std::string& objname)
 {
     buildScene(scenepath, scenename, objname);
@@ -9,6 +65,7 @@ Scene::Scene(std::string& scenepath, std::string& scenename, std::string& objnam
 
 void Scene::buildScene(std::string& scenepath, std::string& scenename, std::string& objname)
 {
+    this->scenepath = scenepath;
     Timer timer;
     timer.start();
     // read camera & light radiance from xml
@@ -19,7 +76,11 @@ void Scene::buildScene(std::string& scenepath, std::string& scenename, std::stri
         ERRORM("Failed to Read XML: %s", xmlDocument.ErrorStr());
     }
     this->cam.initFromXML(xmlDocument); 
+    animation.initFromXML(xmlDocument, cam.getEye(), cam.getLookat(), cam.getUp());
+    textures.setBudget(size_t(settings._texture_budget) * 1048576);
+    bvh_tree.setBuilder(Bvh::builderFromName(settings._bvh), settings._split_growth, settings._threads);
     std::map<std::string, glm::vec3> light_radiance;
+    environment.initFromXML(xmlDocument, scenepath);
     readRadiances(xmlDocument, light_radiance);   
     
     // read obj file (contain mesh & mat name)
@@ -38,12 +99,17 @@ void Scene::buildScene(std::string& scenepath, std::string& scenename, std::stri
     // read materials & textures
     readMaterials(scenepath, material_list, light_radiance);
     saveToScene(shapes, attrib);
+    readInstances(xmlDocument, scenepath, light_radiance);
+    bindMaterials();
+    this->egroup.init(light_objects);
+    INFO("Build Light Groups.\n");
 
     // build buffer & default material
     this->buf.init(cam.getWidth(), cam.getHeight());
-    default_mat = static_cast<shared_ptr<Material>>(
-        std::make_shared<PhongMaterial>());
-    default_mat->_kd = glm::vec3(0.5, 0.5, 0.5);
+    default_mat = Material{};
+    default_mat._type = DIFFUSE;
+    default_mat._kd = glm::vec3(0.5, 0.5, 0.5);
+    default_mat.prepare();
     INFO("Render Image Size: %d x %d (W x H)\n", this->cam.getWidth(), this->cam.getHeight());
 
     timer.end();
@@ -53,6 +119,11 @@ void Scene::buildScene(std::string& scenepath, std::string& scenename, std::stri
     timer.start();
     DEBUGM("Begin Build BVH\n");
     this->bvh_tree.buildTree(bvh_tree.getObjects());
+    bvh_cost = bvh_tree.sahCost();
+    INFO("Compact BVH: %.1f KB\n", bvh_tree.getCompactBytes() / 1024.0);
+    // only animated scenes refit, which needs the build nodes
+    if (!animation.enabled())
+        bvh_tree.releaseBuildNodes();
     DEBUGM("Finish Build BVH\n");
     timer.end();
     timer.printTimeCost("Build BVH Tree");
@@ -64,7 +135,7 @@ void Scene::addObject(Hittable* obj)
     bvh_tree.getObjects().push_back(obj); 
 }
 
-void Scene::addMaterial(shared_ptr<Material> mat)
+void Scene::addMaterial(const Material& mat)
 {
     materials.push_back(mat);
 }
@@ -72,33 +143,343 @@ void Scene::addMaterial(shared_ptr<Material> mat)
 void Scene::render(std::string& output, int spp, int maxdepth)
 {
     buf.setSpp(spp);
+    features.init(cam.getWidth(), cam.getHeight());
+    initGuiding(spp);
+    initCaustics(maxdepth);
+    initRadianceCache();
+    initRoulette();
+    metropolis.clear();
+    RenderStats::reset();
+    double start = omp_get_wtime();
 
     for (int s = 0; s < spp; s++)
     {
         INFO("Render Sample %d\n", s + 1);
-        for (int j = 0; j < cam.getHeight(); j++) {
-            INFO("Height %d\r", j);
-#pragma omp parallel for num_threads(8)
+        renderSample(s, maxdepth);
+        updateGuiding();
+        if (settings._denoise && s < kFeatureSamples)
+            renderFeatures();
+    if((s+1)==1||(s+1)==4|| (s + 1) == 8|| (s + 1) == 16|| (s + 1) == 64|| (s + 1) == 128|| (s + 1) == 256|| (s + 1) == 512|| (s + 1) == 1024|| (s + 1) == 2048|| (s + 1) == 4096)
+    buf.renderToPic("./output/spp_"+std::to_string(s+1)+".jpg", 2.2, s+1);
+    }
+    RenderStats::report(omp_get_wtime() - start);
+    if (settings._denoise)
+        buf.renderToPic("./output/noisy.jpg", 2.2, spp);
+    writeImage(output, spp);
+    textures.printStats();
+    caustics.printStats();
+    radiance_cache.printStats("Radiance cache");
+    rr_cache.printStats("Roulette estimate");
+    metropolis.printStats();
+    return;
+}
+
+void Scene::renderSample(int s, int maxdepth)
+{
+    if (settings._tile_size > 0) {
+        WavefrontRender::renderSample(*this, maxdepth);
+        textures.endPass();
+        return;
+    }
+    if (settings._integrator == "mlt") {
+        metropolis.renderPass(*this, maxdepth);
+        textures.endPass();
+        return;
+    }
+    bool bdpt = settings._integrator == "bdpt";
+    bool adaptive = rr_cache.enabled() && rr_passes >= kMinEstimatePasses;
+    for (int j = 0; j < cam.getHeight(); j++) {
+        INFO("Height %d\r", j);
+#pragma omp parallel num_threads(settings._threads)
+        {
+            STAT_BUSY_SCOPE();
+#pragma omp for nowait
             for (int i = 0; i < cam.getWidth(); ++i) {
                 Ray ray_sample = cam.genRayRandom(i, j);
-                glm::vec3 color = Li(ray_sample, bvh_tree.getObjects(), maxdepth);
+                flt estimate = adaptive ? luminance(buf.getColor(i, j)) / rr_passes : 0;
+                glm::vec3 color = bdpt ? BidirectionalRender::Li(*this, ray_sample, maxdepth)
+                                       : Li(ray_sample, bvh_tree.getObjects(), maxdepth, estimate);
 
                 if (std::isfinite(color[0]) && std::isfinite(color[1]) && std::isfinite(color[2])) {
                     buf.addColor(i, j, color);
                 }
                 else {
+                    STAT_INC(STAT_NONFINITE);
                     DEBUGM("Not finite number at sample %d x %d y %d\n", s, i, j);
                 }
             }
         }
-    if((s+1)==1||(s+1)==4|| (s + 1) == 8|| (s + 1) == 16|| (s + 1) == 64|| (s + 1) == 128|| (s + 1) == 256|| (s + 1) == 512|| (s + 1) == 1024|| (s + 1) == 2048|| (s + 1) == 4096)
-    buf.renderToPic("./output/spp_"+std::to_string(s+1)+".jpg", 2.2, s+1);
     }
-    buf.renderToPic("test.jpg", 2.2, spp);
-    return;
+    rr_passes++;
+    textures.endPass();
+}
+
+// Path guiding trains during the first quarter of the passes, at most
+// kGuideTrainPasses, and refreshes its distributions after 1, 2, 4, ... of them.
+void Scene::initGuiding(int spp)
+{
+    guide_passes = 0;
+    passes_done = 0;
+    if (!settings._guide)
+        return;
+    if (settings._tile_size > 0) {
+        INFO("Path guiding only runs with the per pixel integrator, ignored with --tile\n");
+        return;
+    }
+    if (settings._integrator != "path") {
+        INFO("Path guiding only runs with the path tracer, ignored with --integrator %s\n", settings._integrator.c_str());
+        return;
+    }
+    guide.init(bvh_tree.getBounds());
+    guide_passes = std::min(std::max(spp / 4, 1), kGuideTrainPasses);
+}
+
+void Scene::updateGuiding()
+{
+    if (passes_done >= guide_passes)
+        return;
+    passes_done++;
+    if ((passes_done & (passes_done - 1)) == 0 || passes_done == guide_passes)
+        guide.update();
+}
+
+// Traces the caustic photons for the current frame, Li then adds their density
+// estimate at every diffuse hit.
+void Scene::initCaustics(int maxdepth)
+{
+    caustics.clear();
+    if (settings._caustic_photons <= 0)
+        return;
+    if (settings._tile_size > 0 || settings._integrator != "path") {
+        INFO("Caustic photons only run with the per pixel path tracer, ignored\n");
+        return;
+    }
+    flt radius = settings._caustic_radius;
+    if (radius <= 0) {
+        AABB bounds = bvh_tree.getBounds();
+        radius = kCausticRadiusScale * glm::compMax(bounds.getMax() - bounds.getMin());
+    }
+    Timer timer;
+    timer.start();
+    caustics.build(bvh_tree, egroup, default_mat, settings._caustic_photons, radius, maxdepth, settings._threads);
+    timer.end();
+    timer.printTimeCost("Trace Caustic Photons");
+}
+
+// Li ends paths in the cache after settings._radiance_cache exact diffuse
+// bounces. The cache starts empty each frame and learns from the paths that
+// run to their end.
+void Scene::initRadianceCache()
+{
+    radiance_cache.clear();
+    if (settings._radiance_cache <= 0)
+        return;
+    if (settings._tile_size > 0 || settings._integrator != "path") {
+        INFO("The radiance cache only runs with the per pixel path tracer, ignored\n");
+        return;
+    }
+    radiance_cache.init(bvh_tree.getBounds(), kCacheResolution, kCacheMinSamples, STAT_RADIANCE_CACHE_LOOKUPS);
+}
+
+// Adaptive roulette learns the light reflected at diffuse hits in rr_cache
+// while it renders and compares paths with the image so far.
+void Scene::initRoulette()
+{
+    rr_cache.clear();
+    rr_passes = 0;
+    if (settings._roulette != "adaptive")
+        return;
+    if (settings._tile_size > 0 || settings._integrator != "path") {
+        INFO("Adaptive roulette only runs with the per pixel path tracer, ignored\n");
+        return;
+    }
+    rr_cache.init(bvh_tree.getBounds(), kRouletteResolution, kRouletteMinSamples, STAT_ROULETTE_CACHE_LOOKUPS);
 }
 
-glm::vec3 Scene::Li(Ray& r, std::vector<Hittable*>& objects, int depth)
+// The guide's sampling when this cell has been trained, the bsdf's otherwise.
+flt Scene::sampleBounce(Ray& ray, HitRecord& rec, const glm::vec3& wo, int cell, Ray& scattered)
+{
+    if (cell < 0 || !guide.ready() || !guide.trained(cell))
+        return rec._mat->scatter(ray, rec, scattered);
+    // one sample MIS between the guide and the bsdf
+    if (random_float() < kGuideFraction) {
+        scattered.setOrigin(rec._pos);
+        scattered.setDirection(guide.sample(cell));
+    }
+    else
+        rec._mat->scatter(ray, rec, scattered);
+    glm::vec3 wi = scattered.getDirection();
+    return kGuideFraction * guide.pdf(cell, wi) + (1 - kGuideFraction) * rec._mat->pdf(wi, rec, wo);
+}
+
+// One jittered camera ray per pixel, adds the albedo, normal and depth of the
+// first hit to the feature buffers. Misses add nothing.
+void Scene::renderFeatures()
+{
+#pragma omp parallel for num_threads(settings._threads) schedule(dynamic, 4)
+    for (int j = 0; j < cam.getHeight(); j++) {
+        for (int i = 0; i < cam.getWidth(); i++) {
+            Ray ray = cam.genRayRandom(i, j);
+            HitRecord rec;
+            if (!bvh_tree.hit(ray, kHitEps, INFINITY, rec))
+                continue;
+            const Material* mat = rec._mat ? rec._mat : &default_mat;
+            glm::vec3 normal = glm::dot(rec._normal, ray.getDirection()) < 0 ? rec._normal : -rec._normal;
+            features.add(i, j, mat->albedo(rec), normal, rec._t * glm::length(ray.getDirection()));
+        }
+    }
+    features._samples++;
+}
+
+// Writes buf, through the denoiser when it is on.
+void Scene::writeImage(const std::string& path, int spp)
+{
+    if (!settings._denoise || features._samples == 0) {
+        buf.renderToPic(path, 2.2, spp);
+        return;
+    }
+    Timer timer;
+    timer.start();
+    Buffer denoised;
+    Denoiser::denoise(buf, spp, features, denoised, settings._threads);
+    timer.end();
+    timer.printTimeCost("Denoise");
+    denoised.renderToPic(path, 2.2, 1);
+}
+
+// Accumulate samples [sbegin, send) into buf without writing any picture,
+// a distributed worker saves the raw accumulation afterwards.
+void Scene::renderRange(int sbegin, int send, int maxdepth)
+{
+    buf.setSpp(send - sbegin);
+    initGuiding(send - sbegin);
+    initCaustics(maxdepth);
+    initRadianceCache();
+    initRoulette();
+    metropolis.clear();
+    RenderStats::reset();
+    double start = omp_get_wtime();
+    for (int s = sbegin; s < send; s++)
+    {
+        INFO("Render Sample %d (%d / %d)\n", s + 1, s - sbegin + 1, send - sbegin);
+        renderSample(s, maxdepth);
+        updateGuiding();
+    }
+    RenderStats::report(omp_get_wtime() - start);
+    textures.printStats();
+    caustics.printStats();
+    radiance_cache.printStats("Radiance cache");
+    rr_cache.printStats("Roulette estimate");
+    metropolis.printStats();
+}
+
+// Move everything to the given frame. The BVH is refit in place and only
+// rebuilt when its SAH cost grew past settings._rebuild_ratio of the last build.
+void Scene::setFrame(int frame)
+{
+    Timer timer;
+    timer.start();
+
+    glm::vec3 eye, lookat, up;
+    animation.cameraAt(frame, eye, lookat, up);
+    cam.setView(eye, lookat, up);
+
+    for (auto& animated : animation._instances) {
+        glm::mat4 to_world = animated._track.at(frame);
+        animated._instance->setTransform(to_world);
+        const auto& mesh_lights = animated._instance->getMesh()->_lights;
+        for (size_t i = 0; i < animated._lights.size(); i++)
+            animated._lights[i]->transformFrom(*mesh_lights[i], to_world);
+    }
+    if (!animation._vertices.empty()) {
+        loadFrameVertices(frame);
+    }
+    egroup.init(light_objects);
+
+    bvh_tree.refitObjects();
+    flt cost = bvh_tree.sahCost();
+    bool rebuild = cost > settings._rebuild_ratio * bvh_cost;
+    if (rebuild) {
+        bvh_tree.buildTree(bvh_tree.getObjects());
+        bvh_cost = bvh_tree.sahCost();
+    }
+    timer.end();
+    INFO("Frame %d: SAH cost %.1f (built %.1f), %s\n", frame, cost, bvh_cost, rebuild ? "rebuilt" : "refit");
+    timer.printTimeCost("Update Frame");
+}
+
+void Scene::loadFrameVertices(int frame)
+{
+    tinyobj::ObjReader reader;
+    readMeshes(scenepath + animation._vertices + std::to_string(frame) + ".obj", reader);
+    const auto& shapes = reader.GetShapes();
+    const auto& vertices = reader.GetAttrib().vertices;
+    const auto& normals = reader.GetAttrib().normals;
+
+    // frames without normals keep the ones of the scene and its face normal sides
+    size_t t = 0;
+    for (size_t s = 0; s < shapes.size(); s++) {
+        const auto& indices = shapes[s].mesh.indices;
+        for (size_t f = 0; f + 2 < indices.size(); f += 3) {
+            if (t >= scene_triangles.size())
+                ERRORM("Frame %d has more triangles than the scene\n", frame);
+            glm::vec3 vp[3], vn[3];
+            bool has_normal = true;
+            for (int v = 0; v < 3; v++) {
+                size_t id = 3 * size_t(indices[f + v].vertex_index);
+                vp[v] = glm::vec3(vertices[id + 0], vertices[id + 1], vertices[id + 2]);
+                int normal_index = indices[f + v].normal_index;
+                if (normal_index < 0) {
+                    has_normal = false;
+                    continue;
+                }
+                size_t nid = 3 * size_t(normal_index);
+                if (nid + 2 >= normals.size())
+                    ERRORM("normal id exceed %zu\n", nid + 2);
+                vn[v] = glm::vec3(normals[nid + 0], normals[nid + 1], normals[nid + 2]);
+            }
+            Triangle* tri = scene_triangles[t++];
+            if (has_normal)
+                tri->setVertexNormal(vn[0], vn[1], vn[2]);
+            tri->setPositions(vp[0], vp[1], vp[2]);
+            if (has_normal)
+                tri->orientToVertexNormals();
+        }
+    }
+    if (t != scene_triangles.size())
+        ERRORM("Frame %d has %zu triangles, the scene has %zu\n", frame, t, scene_triangles.size());
+}
+
+void Scene::renderAnimation(int spp, int maxdepth)
+{
+    RenderStats::reset();
+    double start = omp_get_wtime();
+    for (int frame = 0; frame < animation._frames; frame++) {
+        setFrame(frame);
+        buf.clear();
+        buf.setSpp(spp);
+        features.init(cam.getWidth(), cam.getHeight());
+        initGuiding(spp);
+        initCaustics(maxdepth);
+        initRadianceCache();
+        initRoulette();
+        metropolis.clear();
+        for (int s = 0; s < spp; s++) {
+            renderSample(s, maxdepth);
+            updateGuiding();
+            if (settings._denoise && s < kFeatureSamples)
+                renderFeatures();
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "./output/frame_%04d.jpg", frame);
+        writeImage(name, spp);
+        INFO("Frame %d written to %s\n", frame, name);
+    }
+    RenderStats::report(omp_get_wtime() - start);
+    textures.printStats();
+}
+
+glm::vec3 Scene::Li(Ray& r, std::vector<Hittable*>& objects, int depth, flt pixel_estimate)
 {
     glm::vec3 color(0.0f);
     glm::vec3 throughput(1.0f);
@@ -108,81 +489,195 @@ glm::vec3 Scene::Li(Ray& r, std::vector<Hittable*>& objects, int depth)
     bool look_light = true;
     int bounce = 0;
     int in_glass = 0;
-    for (bounce = 0; bounce < depth; bounce++) {  
-        
-        if (!bvh_tree.hit(ray, kHitEps, INFINITY, rec)) {
-            break; // No intersection
-        }
+    bool guiding = guide.ready();
+    bool training = passes_done < guide_passes;
+    GuideVertex vertices[kMaxGuideVertices];
+    int num_vertices = 0;
+    bool caching = radiance_cache.enabled();
+    bool cache_training = caching && random_float() < kCacheTrainFraction;
+    bool cached = false;
+    int diffuse_hits = 0;
+    CacheVertex cache_vertices[kMaxCacheVertices];
+    int num_cache_vertices = 0;
+    bool adaptive = rr_cache.enabled();
+    bool rr_training = adaptive && random_float() < kRouletteTrainFraction;
+    // branches would mix in the color the learners take differences of
+    bool can_split = adaptive && !rr_training && !training && !caching && settings._split_max > 1;
+    CacheVertex rr_vertices[kMaxCacheVertices];
+    int num_rr_vertices = 0;
+    PathBranch branches[kMaxBranches];
+    int num_branches = 0, branches_made = 0;
+    for (;;) {
+        for (; bounce < depth; bounce++) {  
+            STAT_INC(bounce == 0 ? STAT_CAMERA_RAYS : STAT_BOUNCE_RAYS);
+            if (!bvh_tree.hit(ray, kHitEps, INFINITY, rec)) {
+                // after a diffuse hit sampleLight has counted the environment
+                if (look_light && environment.enabled())
+                    color += throughput * environment.Le(ray.getDirection());
+                break; // No intersection
+            }
+            // flat triangles keep the cone spread, only the width grows along the path
+            flt cone_width = ray.coneWidthAt(rec._t);
         
-        if (!rec._mat) {
-            rec._mat = default_mat; // default phong material
-        }
+            if (!rec._mat) {
+                rec._mat = &default_mat; // default phong material
+            }
+            STAT_INC(STAT_HIT_LIGHT + rec._mat->_type);
 
-        //color = rec.mat->kd;
-        //break;
+            //color = rec.mat->kd;
+            //break;
         
-        // material self emissive
-        if (rec._mat->_type == MatType::LIGHT) {
-            if (glm::dot(rec._normal, ray.getDirection()) < 0)
-            {
-                if (look_light)
+            // material self emissive
+            if (rec._mat->_type == MatType::LIGHT) {
+                if (glm::dot(rec._normal, ray.getDirection()) < 0)
                 {
-                    //printVec3(color);
-                    glm::vec3 emissive_color = rec._mat->_ke;
-                    color += throughput * emissive_color;
+                    if (look_light)
+                    {
+                        //printVec3(color);
+                        glm::vec3 emissive_color = rec._mat->_ke;
+                        color += throughput * emissive_color;
+                    }
                 }
+                //DEBUGM("Bounce %d: Light color: %f %f %f\n", bounce, color[0], color[1], color[2]);
+                // ԴǷbounce
+
+                break;
             }
-            //DEBUGM("Bounce %d: Light color: %f %f %f\n", bounce, color[0], color[1], color[2]);
-            // ԴǷbounce
 
-            break;
-        }
+            wo = -ray.getDirection();
+            // material glass
+            if (rec._mat->_type == MatType::GLASS) {
+                in_glass = in_glass + 1;
+                /*DEBUGM("Bounce %d Glass", bounce);*/
+                //break;
+                Ray scattered;
+                flt attenuation = rec._mat->scatter(ray, rec, scattered);
+                wi = scattered.getDirection();
+                throughput *= rec._mat->bsdf(wi, rec, wo);
+                scattered.setCone(cone_width, ray.getConeSpread());
+                ray = scattered;
+                //DEBUGM("Bounce %d: Glass color: %f %f %f\n", bounce, color[0], color[1], color[2]);
 
-        wo = -ray.getDirection();
-        // material glass
-        if (rec._mat->_type == MatType::GLASS) {
-            in_glass = in_glass + 1;
-            /*DEBUGM("Bounce %d Glass", bounce);*/
-            //break;
-            Ray scattered;
-            flt attenuation = rec._mat->scatter(ray, rec, scattered);
-            wi = scattered.getDirection();
-            throughput *= rec._mat->bsdf(wi, rec, wo);
-            ray = scattered;
-            //DEBUGM("Bounce %d: Glass color: %f %f %f\n", bounce, color[0], color[1], color[2]);
+                continue;
+            }
 
-            continue;
-        }
+            look_light = false;
+            rec._normal = glm::dot(rec._normal, wo) > 0 ? rec._normal : -rec._normal;
+            if (caching && rec._mat->_type == DIFFUSE) {
+                glm::vec3 radiance;
+                if (!cache_training && ++diffuse_hits > settings._radiance_cache
+                    && radiance_cache.lookup(rec._pos, rec._normal, radiance)) {
+                    color += throughput * radiance;
+                    cached = true;
+                    break;
+                }
+                if (num_cache_vertices < kMaxCacheVertices)
+                    cache_vertices[num_cache_vertices++] = CacheVertex{ rec._pos, rec._normal, throughput, color };
+            }
+            if (rr_training && num_rr_vertices < kMaxCacheVertices)
+                rr_vertices[num_rr_vertices++] = CacheVertex{ rec._pos, rec._normal, throughput, color };
+            color += throughput * sampleLight(ray, rec);
+            if (!caustics.empty())
+                color += throughput * caustics.gather(rec, wo);
 
-        look_light = false;
-        rec._normal = glm::dot(rec._normal, wo) > 0 ? rec._normal : -rec._normal;
-        color += throughput * sampleLight(ray, rec);
-
-        Ray scattered;      
-        flt pdf = rec._mat->scatter(ray, rec, scattered);
-        wi = scattered.getDirection();
-        if (glm::dot(wi, rec._normal) > 0 && pdf > kEps) {
-            flt cos = fabs(glm::dot(wi, rec._normal));
-            throughput *= rec._mat->bsdf(wi, rec, wo) * cos / pdf;
-            ray = scattered;        
-        }
-        else {
-            break;
-        }
+            // Weight window around the throughput at which the reflected light
+            // would add as much as the pixel holds: kill below it, split above it.
+            int split = 1;
+            bool windowed = false;
+            glm::vec3 reflected;
+            if (adaptive && !rr_training
+                && rr_cache.lookup(rec._pos, rec._normal, reflected) && luminance(reflected) > 0) {
+                // until the image is usable the pixel is taken to be what its first hit reflects
+                if (pixel_estimate <= 0)
+                    pixel_estimate = luminance(throughput * reflected);
+                windowed = true;
+                flt low = 2 * pixel_estimate / (luminance(reflected) * (1 + kWindowWidth));
+                flt w = luminance(throughput);
+                if (w < low) {
+                    flt q = glm::max(w / low, kMinSurvival);
+                    if (random_float() >= q) {
+                        STAT_INC(STAT_RR_TERMINATED);
+                        break;
+                    }
+                    throughput /= q;
+                }
+                else if (can_split && w > kWindowWidth * low) {
+                    split = int(ceilf(w / (kWindowWidth * low)));
+                    split = std::min(std::min(split, settings._split_max), 1 + kMaxBranches - branches_made);
+                }
+            }
 
-        if (bounce >= 3)
-        {
-            flt ran = random_float();
-            if (ran < glm::compMax(throughput))
-                throughput /= glm::compMax(throughput);
-            else
+            int cell = guiding || training ? guide.cellIndex(rec._pos) : -1;
+            if (split > 1) {
+                throughput /= flt(split);
+                for (int k = 1; k < split; k++) {
+                    Ray branch;
+                    flt branch_pdf = sampleBounce(ray, rec, wo, cell, branch);
+                    glm::vec3 branch_wi = branch.getDirection();
+                    flt cos = glm::dot(branch_wi, rec._normal);
+                    if (cos <= 0 || branch_pdf <= kEps)
+                        continue;
+                    branch.setCone(cone_width, ray.getConeSpread());
+                    branches[num_branches++] = PathBranch{ branch, throughput * rec._mat->bsdf(branch_wi, rec, wo) * cos / branch_pdf, bounce + 1 };
+                    branches_made++;
+                }
+            }
+
+            Ray scattered;      
+            flt pdf = sampleBounce(ray, rec, wo, cell, scattered);
+            wi = scattered.getDirection();
+            if (glm::dot(wi, rec._normal) > 0 && pdf > kEps) {
+                flt cos = fabs(glm::dot(wi, rec._normal));
+                throughput *= rec._mat->bsdf(wi, rec, wo) * cos / pdf;
+                scattered.setCone(cone_width, ray.getConeSpread());
+                ray = scattered;        
+            }
+            else {
                 break;
-        }
+            }
+            if (training && num_vertices < kMaxGuideVertices)
+                vertices[num_vertices++] = GuideVertex{ cell, wi, throughput, color, pdf };
+
+            if (!windowed && bounce >= 3)
+            {
+                flt ran = random_float();
+                if (ran < glm::compMax(throughput))
+                    throughput /= glm::compMax(throughput);
+                else {
+                    STAT_INC(STAT_RR_TERMINATED);
+                    break;
+                }
+            }
 
-        //DEBUGM("Bounce %d: color: %f %f %f\n", bounce, color[0], color[1], color[2]);
+            //DEBUGM("Bounce %d: color: %f %f %f\n", bounce, color[0], color[1], color[2]);
 
+        }
+        if (num_branches == 0)
+            break;
+        const PathBranch& branch = branches[--num_branches];
+        ray = branch._ray;
+        throughput = branch._throughput;
+        bounce = branch._bounce;
     }
     //DEBUGM("Return: Bounce %d: color: %f %f %f\n", bounce, color[0], color[1], color[2]);
+
+    // what the path gathered after each vertex is the radiance arriving along its wi
+    for (int v = 0; v < num_vertices; v++) {
+        const GuideVertex& vertex = vertices[v];
+        glm::vec3 incident = (color - vertex._color) / glm::max(vertex._throughput, glm::vec3(kEps));
+        guide.splat(vertex._cell, vertex._wi, glm::dot(incident, glm::vec3(0.2126f, 0.7152f, 0.0722f)) / vertex._pdf);
+    }
+    // only complete paths teach the cache, so it never learns from itself
+    for (int v = 0; v < num_cache_vertices && !cached; v++) {
+        const CacheVertex& vertex = cache_vertices[v];
+        glm::vec3 outgoing = (color - vertex._color) / glm::max(vertex._throughput, glm::vec3(kEps));
+        radiance_cache.splat(vertex._pos, vertex._normal, outgoing);
+    }
+    // the light each vertex reflected toward the path
+    for (int v = 0; v < num_rr_vertices; v++) {
+        const CacheVertex& vertex = rr_vertices[v];
+        rr_cache.splat(vertex._pos, vertex._normal, (color - vertex._color) / glm::max(vertex._throughput, glm::vec3(kEps)));
+    }
     return color;
 }
 
@@ -197,28 +692,47 @@ glm::vec3 Scene::sampleLight(Ray& ray, HitRecord& rec)
     glm::vec3 light_color;
     glm::vec3 color(0.0f);
 
-    // sample light
-    light_pdf = egroup.sampleRay(&bvh_tree, rec, light_ray, light_rec);
-    wi = light_ray.getDirection();
-    bsdf_pdf = rec._mat->pdf(wi, rec, wo);
-    if (light_pdf > kEps && bsdf_pdf > kEps) {
-        flt weight = light_pdf / (light_pdf + bsdf_pdf);
-        //flt weight = 1.0;
-        flt cos = glm::dot(wi, rec._normal);
-        glm::vec3 bsdf = rec._mat->bsdf(wi, rec, wo);
-        if (light_rec._mat) {
-            light_color = light_rec._mat->_ke;
-        }
-        else {
-            ERRORM("The light has no material.");
+    if (environment.enabled())
+        color += sampleEnvironment(ray, rec);
+    if (egroup.empty())
+        return color;
+
+    // resampled light points carry the whole estimate, no bsdf sample
+    if (settings._restir > 0) {
+        LightReservoir reservoir;
+        ResampledLights::sample(egroup, rec, wo, settings._restir, reservoir);
+        return color + ResampledLights::shade(bvh_tree, rec, wo, reservoir);
+    }
+
+    // several light points share one batched shadow query
+    int light_samples = std::max(1, settings._light_samples);
+    if (light_samples > 1)
+        color += sampleLightBatch(rec, wo, light_samples);
+    else {
+        // sample light
+        light_pdf = egroup.sampleRay(&bvh_tree, rec, light_ray, light_rec);
+        wi = light_ray.getDirection();
+        bsdf_pdf = rec._mat->pdf(wi, rec, wo);
+        if (light_pdf > kEps && bsdf_pdf > kEps) {
+            flt weight = light_pdf / (light_pdf + bsdf_pdf);
+            //flt weight = 1.0;
+            flt cos = glm::dot(wi, rec._normal);
+            glm::vec3 bsdf = rec._mat->bsdf(wi, rec, wo);
+            if (light_rec._mat) {
+                light_color = light_rec._mat->_ke;
+            }
+            else {
+                ERRORM("The light has no material.");
+            }
+            color += weight * light_color * bsdf * cos / light_pdf;
         }
-        color += weight * light_color * bsdf * cos / light_pdf;
     }
 
     // sample bsdf
     bsdf_pdf = rec._mat->scatter(ray, rec, light_ray);
     wi = light_ray.getDirection();
     // sample hit light
+    STAT_INC(STAT_SHADOW_RAYS);
     bool flaghit = bvh_tree.hit(light_ray, kHitEps, FLT_MAX, light_rec);
     bool flaghitlight = false;
     bool flaglightdirect = false;
@@ -232,7 +746,7 @@ glm::vec3 Scene::sampleLight(Ray& ray, HitRecord& rec)
     {
         light_pdf = egroup.pdf(rec, light_rec);
         if (light_pdf > kEps && bsdf_pdf > kEps) {
-            flt weight = bsdf_pdf / (light_pdf + bsdf_pdf);
+            flt weight = bsdf_pdf / (light_samples * light_pdf + bsdf_pdf);
             //flt weight = 1.0;
             flt cos = glm::dot(wi, rec._normal);
             glm::vec3 bsdf = rec._mat->bsdf(wi, rec, wo);
@@ -251,12 +765,89 @@ glm::vec3 Scene::sampleLight(Ray& ray, HitRecord& rec)
     return color;
 }
 
+// n points drawn on the lights by area, each weighted by the balance heuristic
+// against the single bsdf sample of sampleLight. All shadow rays leave rec._pos,
+// so they go down the BVH together.
+glm::vec3 Scene::sampleLightBatch(HitRecord& rec, const glm::vec3& wo, int n)
+{
+    glm::vec3 color(0.0f);
+    glm::vec3 dirs[Bvh::kMaxShadowBatch];
+    flt tmax[Bvh::kMaxShadowBatch];
+    glm::vec3 radiance[Bvh::kMaxShadowBatch];
+    bool blocked[Bvh::kMaxShadowBatch];
+
+    for (int first = 0; first < n; first += Bvh::kMaxShadowBatch) {
+        int count = 0;
+        for (int i = first; i < std::min(n, first + Bvh::kMaxShadowBatch); i++) {
+            HitRecord light_rec;
+            if (egroup.sampleSurface(light_rec) <= 0 || !light_rec._mat)
+                continue;
+            glm::vec3 d = light_rec._pos - rec._pos;
+            flt dist = glm::length(d);
+            if (dist <= kEps)
+                continue;
+            glm::vec3 wi = d / dist;
+            flt cos = glm::dot(wi, rec._normal);
+            if (cos <= 0 || glm::dot(wi, light_rec._normal) >= 0)
+                continue;
+            flt light_pdf = egroup.pdf(rec, light_rec);
+            flt bsdf_pdf = rec._mat->pdf(wi, rec, wo);
+            if (light_pdf <= kEps || bsdf_pdf <= kEps)
+                continue;
+            dirs[count] = wi;
+            tmax[count] = dist * (1 - 1e-4f);
+            radiance[count] = light_rec._mat->_ke * rec._mat->bsdf(wi, rec, wo) * cos / (n * light_pdf + bsdf_pdf);
+            count++;
+        }
+        if (count == 0)
+            continue;
+        STAT_ADD(STAT_SHADOW_RAYS, count);
+        bvh_tree.occluded(rec._pos, dirs, tmax, count, kHitEps, blocked);
+        for (int i = 0; i < count; i++) {
+            if (!blocked[i])
+                color += radiance[i];
+        }
+    }
+    return color;
+}
+
+// One direction from the environment map and one from the bsdf, combined with
+// the balance heuristic. Either counts only if its ray leaves the scene.
+glm::vec3 Scene::sampleEnvironment(Ray& ray, HitRecord& rec)
+{
+    glm::vec3 color(0.0f);
+    glm::vec3 wo = -ray.getDirection();
+    glm::vec3 wi;
+    HitRecord tmp;
+
+    flt env_pdf = environment.sample(wi);
+    flt cos = glm::dot(wi, rec._normal);
+    if (env_pdf > kEps && cos > 0) {
+        STAT_INC(STAT_SHADOW_RAYS);
+        if (!bvh_tree.hit(Ray(rec._pos, wi), kHitEps, INFINITY, tmp)) {
+            flt bsdf_pdf = rec._mat->pdf(wi, rec, wo);
+            color += environment.Le(wi) * rec._mat->bsdf(wi, rec, wo) * cos / (env_pdf + bsdf_pdf);
+        }
+    }
+
+    Ray scattered;
+    flt bsdf_pdf = rec._mat->scatter(ray, rec, scattered);
+    wi = scattered.getDirection();
+    cos = glm::dot(wi, rec._normal);
+    if (bsdf_pdf > kEps && cos > 0) {
+        STAT_INC(STAT_SHADOW_RAYS);
+        if (!bvh_tree.hit(Ray(rec._pos, wi), kHitEps, INFINITY, tmp))
+            color += environment.Le(wi) * rec._mat->bsdf(wi, rec, wo) * cos / (environment.pdf(wi) + bsdf_pdf);
+    }
+    return color;
+}
+
 void Scene::readRadiances(
     const tinyxml2::XMLDocument& xmlconfig,
     std::map<std::string, glm::vec3>& light_radiance)
 {
     auto lightNode = xmlconfig.FirstChildElement("light");
-    if (!lightNode) {
+    if (!lightNode && !environment.enabled()) {
         ERRORM("No light source found in xml file\n");
     }
     while (lightNode) {
@@ -281,6 +872,119 @@ void Scene::readRadiances(
     }
 }
 
+// <instance obj="chair" translate="x,y,z" rotate="x,y,z" scale="x,y,z"/>
+// rotate is in degrees around x, then y, then z; every attribute is optional except obj.
+// <key frame="n" .../> children animate the instance (see Animation).
+void Scene::readInstances(
+    const tinyxml2::XMLDocument& xmlconfig,
+    const std::string& scenepath,
+    std::map<std::string, glm::vec3>& light_radiance)
+{
+    Timer timer;
+    timer.start();
+    int count = 0;
+    auto instanceNode = xmlconfig.FirstChildElement("instance");
+    while (instanceNode) {
+        auto obj = instanceNode->Attribute("obj");
+        if (!obj) {
+            ERRORM("instance has no attribute name \"obj\"\n");
+        }
+        std::string objname(obj);
+
+        TransformKey base;
+        base.initFromXML(instanceNode);
+        base._frame = 0;
+        glm::mat4 to_world = base.matrix();
+
+        if (!meshes.count(objname)) {
+            meshes.insert(std::make_pair(objname, loadMesh(scenepath, objname, light_radiance)));
+        }
+        shared_ptr<Mesh> mesh = meshes[objname];
+        Instance* instance = new Instance(mesh, to_world);
+        addObject(static_cast<Hittable*>(instance));
+
+        // lights are few, they are copied into world space so they can be sampled
+        std::vector<Triangle*> lights;
+        for (Triangle* light : mesh->_lights) {
+            Triangle* tri = light->transformed(to_world);
+            addObject(static_cast<Hittable*>(tri));
+            light_objects.push_back(static_cast<shared_ptr<Emissive>>(tri));
+            lights.push_back(tri);
+        }
+
+        // animated instance, base transform is the key at frame 0
+        auto keyNode = instanceNode->FirstChildElement("key");
+        if (keyNode) {
+            AnimatedInstance animated;
+            animated._instance = instance;
+            animated._lights = lights;
+            animated._track._keys.push_back(base);
+            while (keyNode) {
+                TransformKey key = animated._track._keys.back();
+                key.initFromXML(keyNode);
+                animated._track._keys.push_back(key);
+                keyNode = keyNode->NextSiblingElement("key");
+            }
+            std::stable_sort(animated._track._keys.begin(), animated._track._keys.end(),
+                [](const TransformKey& a, const TransformKey& b) { return a._frame < b._frame; });
+            animation._instances.push_back(animated);
+        }
+        count++;
+        DEBUGM("Instance %d of %s\n", count, objname.c_str());
+
+        instanceNode = instanceNode->NextSiblingElement("instance");
+    }
+    if (count > 0) {
+        timer.end();
+        INFO("Instance Count: %d of %d meshes\n", count, int(meshes.size()));
+        timer.printTimeCost("Read Instances");
+    }
+}
+
+// Point every object at its material. The table only grows while the OBJ
+// files are read, so this runs once they all are.
+void Scene::bindMaterials()
+{
+    for (Hittable* obj : bvh_tree.getObjects()) {
+        if (obj->_mat_id >= 0)
+            obj->_mat = &materials[obj->_mat_id];
+    }
+    for (auto& mesh : meshes) {
+        for (Hittable* obj : mesh.second->_triangles)
+            obj->_mat = &materials[obj->_mat_id];
+        for (Triangle* tri : mesh.second->_lights)
+            tri->_mat = &materials[tri->_mat_id];
+    }
+}
+
+shared_ptr<Mesh> Scene::loadMesh(
+    const std::string& scenepath,
+    const std::string& objname,
+    std::map<std::string, glm::vec3>& light_radiance)
+{
+    tinyobj::ObjReader reader;
+    readMeshes(scenepath + objname + ".obj", reader);
+
+    int material_offset = int(materials.size());
+    readMaterials(scenepath, reader.GetMaterials(), light_radiance);
+
+    std::vector<Triangle*> triangles;
+    readTriangles(reader.GetShapes(), reader.GetAttrib(), material_offset, triangles);
+
+    shared_ptr<Mesh> mesh = make_shared<Mesh>();
+    mesh->_name = objname;
+    for (Triangle* tri : triangles) {
+        if (materials[tri->_mat_id]._type == LIGHT)
+            mesh->_lights.push_back(tri);
+        else
+            mesh->_triangles.push_back(static_cast<Hittable*>(tri));
+    }
+    mesh->_bvh.setBuilder(Bvh::builderFromName(settings._bvh), settings._split_growth, settings._threads);
+    mesh->build();
+    INFO("Mesh %s: %d triangles, %d lights\n", objname.c_str(), int(mesh->_triangles.size()), int(mesh->_lights.size()));
+    return mesh;
+}
+
 void Scene::readMeshes(const std::string& inputfile,
     tinyobj::ObjReader& objreader)
 {
@@ -304,86 +1008,82 @@ void Scene::readMaterials(
     std::map<std::string, glm::vec3>& light_radiance)
 {
     for (const auto& material_loader : material_info) {
-        shared_ptr<Material> material;
-        if (material_loader.ior > 1.0f)
-        {
-            material = make_shared<GlassMaterial>();
-            material->_type = GLASS;
-        }
-        else
-        {
-            material = make_shared<PhongMaterial>();
-            material->_type = DIFFUSE;
-        }
-        material->_name = material_loader.name;
+        Material material{};
+        material._type = material_loader.ior > 1.0f ? GLASS : DIFFUSE;
 
         // Kd
         for (int i = 0; i < 3; i++) {
-            material->_kd[i] = material_loader.diffuse[i];
+            material._kd[i] = material_loader.diffuse[i];
         }
 
         // Ks
         for (int i = 0; i < 3; i++) {
-            material->_ks[i] = material_loader.specular[i];
+            material._ks[i] = material_loader.specular[i];
         }
 
         // tr
         for (int i = 0; i < 3; i++) {
-            material->_tr[i] = material_loader.transmittance[i];
+            material._tr[i] = material_loader.transmittance[i];
         }
 
         // brightness and refraction
-        material->_ns = material_loader.shininess;
-        material->_ni = material_loader.ior;
+        material._ns = material_loader.shininess;
+        material._ni = material_loader.ior;
 
         // if a material give out light
         if (light_radiance.count(material_loader.name)) {
             glm::vec3 emissive = light_radiance[material_loader.name];
-            material->_ke = emissive;
-            material->_is_emissive = true;
-            material->_type = LIGHT;
+            material._ke = emissive;
+            material._is_emissive = true;
+            material._type = LIGHT;
         }
 
         // if a material has texture
         if (material_loader.diffuse_texname.length() > 0) {
-            material->_has_texture = true;
-            auto& texture = material->_texture;
-            int load_channel;
-            int texture_width, texture_height;
-            flt* texture_data = stbi_loadf((objectdir + material_loader.diffuse_texname).c_str(),
-                &texture_width, &texture_height, &load_channel, picChannel);
-            if (!texture_data) {
-                ERRORM("Cannot load texture %s\n", material_loader.diffuse_texname.c_str());
-            }
-            if (load_channel != 3) {
-                ERRORM("The channel of input texture is not equal to 3\n");
-            }
-
-            texture.setSize(texture_width, texture_height);
-            texture.setData(texture_data);
-
+            material._has_texture = true;
+            // decoded lazily by the cache on the first lookup
+            material._texture = textures.get(objectdir + material_loader.diffuse_texname).get();
         }
 
         DEBUGM("Material Name: %s Type: %d\nKd: %f %f %f Ks: %f %f %f\nTr: %f %f %f Ke: %f %f %f\nNs: %f Ni: %f Has_Tex: %d\n",
-            material->_name.c_str(), material->_type,
-            material->_kd[0], material->_kd[1], material->_kd[2],
-            material->_ks[0], material->_ks[1], material->_ks[2],
-            material->_tr[0], material->_tr[1], material->_tr[2],
-            material->_ke[0], material->_ke[1], material->_ke[2],
-            material->_ns, material->_ni,
-            material->_has_texture);
+            material_loader.name.c_str(), material._type,
+            material._kd[0], material._kd[1], material._kd[2],
+            material._ks[0], material._ks[1], material._ks[2],
+            material._tr[0], material._tr[1], material._tr[2],
+            material._ke[0], material._ke[1], material._ke[2],
+            material._ns, material._ni,
+            material._has_texture);
 
-        addMaterial(static_cast<shared_ptr<Material>>(material));
+        material.prepare();
+        addMaterial(material);
     }
     INFO("Material Count: %d\n", materials.size());
+    INFO("Texture Count: %d\n", textures.getTextureCount());
 }
 
 void Scene::saveToScene(
     const std::vector<tinyobj::shape_t>& shapes,
     const tinyobj::attrib_t& attrib)
 {
-    std::vector<shared_ptr<Emissive>> light_objects;
+    std::vector<Triangle*> triangles;
+    readTriangles(shapes, attrib, 0, triangles);
+    scene_triangles = triangles;
+    for (Triangle* tri : triangles) {
+        addObject(static_cast<Hittable*>(tri));
 
+        // light triangles
+        if (materials[tri->_mat_id]._type == LIGHT) {
+            light_objects.push_back(static_cast<shared_ptr<Emissive>>(tri));
+        }
+    }
+}
+
+void Scene::readTriangles(
+    const std::vector<tinyobj::shape_t>& shapes,
+    const tinyobj::attrib_t& attrib,
+    int material_offset,
+    std::vector<Triangle*>& triangles)
+{
     DEBUGM("Object Count: %d\n", shapes.size());
     for (size_t s = 0; s < shapes.size(); s++) {
         size_t point_index_offset = 0;
@@ -440,19 +1140,11 @@ void Scene::saveToScene(
             if (has_uv) {
                 tri->setVertexTexCoord(vt[0], vt[1], vt[2]);
             }
-            int material_id = shapes[s].mesh.material_ids[f];
-            if (material_id >= materials.size())
+            int material_id = shapes[s].mesh.material_ids[f] + material_offset;
+            if (material_id < material_offset || size_t(material_id) >= materials.size())
                 ERRORM("material_id exceed %d\n", material_id);
-            tri->_mat = materials[material_id];
-            addObject(static_cast<Hittable*>(tri));
-
-            // light triangles
-            if (tri->_mat->_type == LIGHT) {
-                light_objects.push_back(static_cast<shared_ptr<Emissive>>(tri));
-            }
+            tri->_mat_id = material_id;
+            triangles.push_back(tri);
         }
     }
-
-    this->egroup.init(light_objects);
-    INFO("Build Light Groups.\n");
 }
@@ -10,16 +10,45 @@
 #include "BVH.hpp"
 #include "Emissive.hpp"
 #include "Timer.hpp"
+#include "Settings.hpp"
+#include "TextureCache.hpp"
+#include "Instance.hpp"
+#include "Animation.hpp"
+#include "Denoiser.hpp"
+#include "Guiding.hpp"
+#include "PhotonMap.hpp"
+#include "RadianceCache.hpp"
+#include "Environment.hpp"
+#include "MLT.hpp"
 
 class Scene
 {
 public:
 	Camera cam;
 	Buffer buf;
+	FeatureBuffer features;	// filled only when denoising
+	GuideField guide;
+	int guide_passes = 0;	// passes that train the guide
+	int passes_done = 0;
+	CausticMap caustics;	// empty unless settings._caustic_photons > 0
+	RadianceCache radiance_cache;	// enabled when settings._radiance_cache > 0
+	RadianceCache rr_cache;	// reflected indirect light, enabled by adaptive roulette
+	int rr_passes = 0;	// passes accumulated in buf since the roulette was reset
+	MetropolisRender metropolis;	// chains of the mlt integrator
+	RenderSettings settings;
 	Bvh bvh_tree;
 	EmissiveGroup egroup;
-	std::vector<shared_ptr<Material>> materials;
-	shared_ptr<Material> default_mat;
+	EnvironmentLight environment;	// enabled by an <environment> element of the xml
+	std::vector<Material> materials;	// flat table, objects point into it once loading is done
+	TextureCache textures;
+	std::map<std::string, shared_ptr<Mesh>> meshes;
+	std::vector<shared_ptr<Emissive>> light_objects;
+	std::vector<Triangle*> scene_triangles;	// triangles of the scene OBJ, in file order
+	Animation animation;
+	std::string scenepath;
+	flt bvh_cost = 0;	// SAH cost right after the last build
+	long long extension_rays = 0;	// counted by the wavefront integrator
+	Material default_mat;
 
 	void readMeshes(
 		const std::string& inputfile, 
@@ -34,15 +63,44 @@ public:
 	void saveToScene(
 		const std::vector<tinyobj::shape_t>& shapes,
 		const tinyobj::attrib_t& attrib);
+	void readTriangles(
+		const std::vector<tinyobj::shape_t>& shapes,
+		const tinyobj::attrib_t& attrib,
+		int material_offset,
+		std::vector<Triangle*>& triangles);
+	void readInstances(
+		const tinyxml2::XMLDocument& xmlconfig,
+		const std::string& scenepath,
+		std::map<std::string, glm::vec3>& light_radiance);
+	void bindMaterials();
+	shared_ptr<Mesh> loadMesh(
+		const std::string& scenepath,
+		const std::string& objname,
+		std::map<std::string, glm::vec3>& light_radiance);
 
 public:
 	Scene() {}
 	Scene(std::string& scenepath, std::string& scenename, std::string& objname);
 	void buildScene(std::string& scenepath, std::string& scenename, std::string& objname);
 	void addObject(Hittable* obj);
-	void addMaterial(shared_ptr<Material> mat);
-	glm::vec3 Li(Ray& r, std::vector<Hittable*>& objects, int depth);
+	void addMaterial(const Material& mat);
+	glm::vec3 Li(Ray& r, std::vector<Hittable*>& objects, int depth, flt pixel_estimate = 0);
+	flt sampleBounce(Ray& ray, HitRecord& rec, const glm::vec3& wo, int cell, Ray& scattered);
 	glm::vec3 sampleLight(Ray& ray, HitRecord& rec);
+	glm::vec3 sampleLightBatch(HitRecord& rec, const glm::vec3& wo, int n);
+	glm::vec3 sampleEnvironment(Ray& ray, HitRecord& rec);
 
 	void render(std::string& output, int spp, int maxdepth);
+	void renderSample(int s, int maxdepth);
+	void renderFeatures();
+	void initGuiding(int spp);
+	void updateGuiding();
+	void initCaustics(int maxdepth);
+	void initRadianceCache();
+	void initRoulette();
+	void writeImage(const std::string& path, int spp);
+	void renderRange(int sbegin, int send, int maxdepth);
+	void setFrame(int frame);
+	void loadFrameVertices(int frame);
+	void renderAnimation(int spp, int maxdepth);
 };
\ No newline at end of file
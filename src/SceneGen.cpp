@@ -0,0 +1,230 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "SceneGen.hpp"
+
+namespace {
+
+const int kSphereRings = 16;
+const int kSphereSegments = 32;
+const long long kSphereTriangles = 2LL * kSphereSegments * (kSphereRings - 1);
+
+}
+
+flt SceneGenerator::uniform(flt lo, flt hi)
+{
+	return std::uniform_real_distribution<flt>(lo, hi)(_rng);
+}
+
+glm::vec3 SceneGenerator::direction()
+{
+	flt z = uniform(-1, 1), a = uniform(0, 2 * pi);
+	flt r = sqrtf(1 - z * z);
+	return glm::vec3(r * cosf(a), r * sinf(a), z);
+}
+
+long long SceneGenerator::vertex(const glm::vec3& v)
+{
+	fprintf(_obj, "v %.6g %.6g %.6g\n", v.x, v.y, v.z);
+	return ++_num_vertices;
+}
+
+void SceneGenerator::triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	long long i = vertex(a);
+	vertex(b);
+	vertex(c);
+	fprintf(_obj, "f %lld %lld %lld\n", i, i + 1, i + 2);
+	_num_faces++;
+}
+
+// div x div grid over the parallelogram p, p + u, p + u + v, p + v, facing cross(u, v)
+void SceneGenerator::quad(const glm::vec3& p, const glm::vec3& u, const glm::vec3& v, int div)
+{
+	long long first = _num_vertices + 1;
+	for (int j = 0; j <= div; j++)
+		for (int i = 0; i <= div; i++)
+			vertex(p + u * (flt(i) / div) + v * (flt(j) / div));
+	for (int j = 0; j < div; j++) {
+		for (int i = 0; i < div; i++) {
+			long long a = first + j * (div + 1) + i;
+			long long b = a + 1, c = a + div + 2, d = a + div + 1;
+			fprintf(_obj, "f %lld %lld %lld\nf %lld %lld %lld\n", a, b, c, a, c, d);
+		}
+	}
+	_num_faces += 2LL * div * div;
+}
+
+void SceneGenerator::material(const char* name)
+{
+	fprintf(_obj, "usemtl %s\n", name);
+}
+
+// square emitter facing down
+void SceneGenerator::light(const glm::vec3& center, flt size)
+{
+	material("Light");
+	quad(center - glm::vec3(size, 0, size) * 0.5f, glm::vec3(size, 0, 0), glm::vec3(0, 0, size));
+}
+
+void SceneGenerator::randomTriangles(long long count)
+{
+	// keep the covered fraction of the cube about the same at every count
+	flt edge = 2.5f / cbrtf(flt(count));
+	material("white");
+	for (long long i = 0; i < count; i++) {
+		glm::vec3 p(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1));
+		triangle(p, p + direction() * edge, p + direction() * edge);
+	}
+	light(glm::vec3(0, 1.5f, 0), 1.0f);
+	_eye = glm::vec3(2.2f, 1.6f, 3.2f);
+	_lookat = glm::vec3(0);
+	_radiance = glm::vec3(10);
+}
+
+void SceneGenerator::thinTriangles(long long count)
+{
+	material("white");
+	for (long long i = 0; i < count; i++) {
+		glm::vec3 p(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1));
+		glm::vec3 d = direction();
+		glm::vec3 side = glm::normalize(glm::cross(d, direction())) * 0.002f;
+		triangle(p - d * 0.5f, p + d * 0.5f, p + side);
+	}
+	light(glm::vec3(0, 1.5f, 0), 1.0f);
+	_eye = glm::vec3(2.2f, 1.6f, 3.2f);
+	_lookat = glm::vec3(0);
+	_radiance = glm::vec3(10);
+}
+
+void SceneGenerator::sphereField(long long count)
+{
+	const char* materials[] = { "white", "red", "green", "glass" };
+	long long spheres = std::max(1LL, (count + kSphereTriangles - 1) / kSphereTriangles);
+	int side = int(ceil(sqrt(double(spheres))));
+	flt spacing = 2.5f;
+	flt half = side * spacing * 0.5f;
+
+	material("white");
+	quad(glm::vec3(-half, 0, half), glm::vec3(2 * half, 0, 0), glm::vec3(0, 0, -2 * half));
+
+	for (long long s = 0; s < spheres; s++) {
+		flt radius = uniform(0.5f, 1.0f);
+		glm::vec3 center((s % side + 0.5f) * spacing - half, radius, (s / side + 0.5f) * spacing - half);
+		material(materials[s % 4]);
+
+		long long north = vertex(center + glm::vec3(0, radius, 0));
+		for (int r = 1; r < kSphereRings; r++) {
+			flt theta = pi * r / kSphereRings;
+			for (int k = 0; k < kSphereSegments; k++) {
+				flt phi = 2 * pi * k / kSphereSegments;
+				vertex(center + radius * glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)));
+			}
+		}
+		long long south = vertex(center - glm::vec3(0, radius, 0));
+
+		for (int k = 0; k < kSphereSegments; k++) {
+			int k1 = (k + 1) % kSphereSegments;
+			fprintf(_obj, "f %lld %lld %lld\n", north, north + 1 + k1, north + 1 + k);
+			long long last = north + 1 + (kSphereRings - 2) * kSphereSegments;
+			fprintf(_obj, "f %lld %lld %lld\n", south, last + k, last + k1);
+			for (int r = 0; r + 2 < kSphereRings; r++) {
+				long long a = north + 1 + r * kSphereSegments;
+				long long b = a + kSphereSegments;
+				fprintf(_obj, "f %lld %lld %lld\nf %lld %lld %lld\n", a + k, a + k1, b + k1, a + k, b + k1, b + k);
+			}
+		}
+		_num_faces += kSphereTriangles;
+	}
+
+	flt top = 2.0f + side * spacing * 0.5f;
+	light(glm::vec3(0, top, 0), half);
+	_eye = glm::vec3(0, top, half * 2.2f + 2.0f);
+	_lookat = glm::vec3(0);
+	_radiance = glm::vec3(8);
+}
+
+void SceneGenerator::cornellBox(long long count, int lights)
+{
+	// five walls of div x div quads
+	int div = std::max(1, int(ceil(sqrt(count / 10.0))));
+	material("white");
+	quad(glm::vec3(-1, 0, 1), glm::vec3(2, 0, 0), glm::vec3(0, 0, -2), div);	// floor
+	quad(glm::vec3(-1, 2, -1), glm::vec3(2, 0, 0), glm::vec3(0, 0, 2), div);	// ceiling
+	quad(glm::vec3(-1, 0, -1), glm::vec3(2, 0, 0), glm::vec3(0, 2, 0), div);	// back
+	material("red");
+	quad(glm::vec3(-1, 0, 1), glm::vec3(0, 0, -2), glm::vec3(0, 2, 0), div);
+	material("green");
+	quad(glm::vec3(1, 0, -1), glm::vec3(0, 0, 2), glm::vec3(0, 2, 0), div);
+
+	// light quads on a grid under the ceiling, same total area for any count
+	int cols = int(ceil(sqrt(double(lights))));
+	flt cell = 1.2f / cols;
+	for (int l = 0; l < lights; l++) {
+		glm::vec3 center((l % cols + 0.5f) * cell - 0.6f, 1.99f, (l / cols + 0.5f) * cell - 0.6f);
+		light(center, cell * 0.5f);
+	}
+	_eye = glm::vec3(0, 1, 3.5f);
+	_lookat = glm::vec3(0, 1, 0);
+	_radiance = glm::vec3(17, 12, 4) * (1.0f / (lights * cell * cell));
+}
+
+void SceneGenerator::writeMaterials(const std::string& path)
+{
+	FILE* mtl = fopen(path.c_str(), "w");
+	if (!mtl) {
+		ERRORM("Cannot write %s\n", path.c_str());
+	}
+	fprintf(mtl,
+		"newmtl white\nKd 0.7 0.7 0.7\nKs 0 0 0\nNs 1\nNi 1\n"
+		"newmtl red\nKd 0.6 0.1 0.1\nKs 0.2 0.2 0.2\nNs 20\nNi 1\n"
+		"newmtl green\nKd 0.1 0.6 0.1\nKs 0 0 0\nNs 1\nNi 1\n"
+		"newmtl glass\nKd 0 0 0\nKs 1 1 1\nTf 0.9 0.9 0.9\nNs 1\nNi 1.5\n"
+		"newmtl Light\nKd 0 0 0\nNs 1\nNi 1\n");
+	fclose(mtl);
+}
+
+void SceneGenerator::writeXml(const std::string& path) const
+{
+	FILE* xml = fopen(path.c_str(), "w");
+	if (!xml) {
+		ERRORM("Cannot write %s\n", path.c_str());
+	}
+	fprintf(xml, "<camera type=\"perspective\" width=\"256\" height=\"256\" fovy=\"45\">\n");
+	fprintf(xml, "  <eye x=\"%g\" y=\"%g\" z=\"%g\"/>\n", _eye.x, _eye.y, _eye.z);
+	fprintf(xml, "  <lookat x=\"%g\" y=\"%g\" z=\"%g\"/>\n", _lookat.x, _lookat.y, _lookat.z);
+	fprintf(xml, "  <up x=\"0\" y=\"1\" z=\"0\"/>\n</camera>\n");
+	fprintf(xml, "<light mtlname=\"Light\" radiance=\"%g,%g,%g\"/>\n", _radiance.x, _radiance.y, _radiance.z);
+	fclose(xml);
+}
+
+void SceneGenerator::generate(const RenderSettings& settings)
+{
+	const std::string& kind = settings._generate;
+	std::string base = settings._scene_dir + settings._obj_name;
+	FILE* obj = fopen((base + ".obj").c_str(), "w");
+	if (!obj) {
+		ERRORM("Cannot write %s.obj\n", base.c_str());
+	}
+	std::vector<char> io_buffer(1 << 20);
+	setvbuf(obj, io_buffer.data(), _IOFBF, io_buffer.size());
+	fprintf(obj, "mtllib %s.mtl\no %s\n", settings._obj_name.c_str(), kind.c_str());
+
+	SceneGenerator gen(obj, settings._seed);
+	long long count = std::max(1LL, settings._gen_count);
+	if (kind == "random")
+		gen.randomTriangles(count);
+	else if (kind == "spheres")
+		gen.sphereField(count);
+	else if (kind == "cornell")
+		gen.cornellBox(count, std::max(1, settings._gen_lights));
+	else if (kind == "thin")
+		gen.thinTriangles(count);
+	else {
+		ERRORM("Unknown scene kind %s\n", kind.c_str());
+	}
+	fclose(obj);
+
+	writeMaterials(base + ".mtl");
+	gen.writeXml(settings._scene_dir + settings._scene_name + ".xml");
+	INFO("Generated %s scene: %lld triangles, %lld vertices\n", kind.c_str(), gen._num_faces, gen._num_vertices);
+}
@@ -0,0 +1,47 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Settings.hpp"
+
+// Writes a synthetic scene of a requested size into the scene folder, as
+// <obj name>.obj/.mtl plus a <scene name>.xml with a camera and the lights,
+// so it loads like any other scene. Kinds:
+//   random   N small triangles scattered in a cube
+//   spheres  a grid of tessellated spheres on a floor, N triangles in total
+//   cornell  a Cornell box with walls split into N triangles and M light quads
+//   thin     N long slivers crossing the cube, the worst case for BVH overlap
+class SceneGenerator
+{
+public:
+	static void generate(const RenderSettings& settings);
+
+private:
+	FILE* _obj;
+	long long _num_vertices = 0;
+	long long _num_faces = 0;
+	std::mt19937 _rng;
+
+	// what the xml gets
+	glm::vec3 _eye, _lookat;
+	glm::vec3 _radiance;
+
+	SceneGenerator(FILE* obj, unsigned int seed) : _obj(obj), _rng(seed) {}
+
+	flt uniform(flt lo, flt hi);
+	glm::vec3 direction();
+
+	long long vertex(const glm::vec3& v);
+	void triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+	void quad(const glm::vec3& p, const glm::vec3& u, const glm::vec3& v, int div = 1);
+	void material(const char* name);
+	void light(const glm::vec3& center, flt size);
+
+	void randomTriangles(long long count);
+	void sphereField(long long count);
+	void cornellBox(long long count, int lights);
+	void thinTriangles(long long count);
+
+	static void writeMaterials(const std::string& path);
+	void writeXml(const std::string& path) const;
+};
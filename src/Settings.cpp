@@ -0,0 +1,98 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "Settings.hpp"
+
+bool RenderSettings::set(const std::string& key, const std::string& value)
+{
+    if (key == "spp") _spp = std::stoi(value);
+    else if (key == "depth") _max_depth = std::stoi(value);
+    else if (key == "threads") _threads = std::stoi(value);
+    else if (key == "output") _output = value;
+    else if (key == "rebuild") _rebuild_ratio = std::stof(value);
+    else if (key == "texbudget") _texture_budget = std::stoi(value);
+    else if (key == "bvh") _bvh = value;
+    else if (key == "splitgrowth") _split_growth = std::stof(value);
+    else if (key == "integrator") _integrator = value;
+    else if (key == "mltchains") _mlt_chains = std::stoi(value);
+    else if (key == "tile") _tile_size = std::stoi(value);
+    else if (key == "sort") _sort_rays = std::stoi(value) != 0;
+    else if (key == "guide") _guide = std::stoi(value) != 0;
+    else if (key == "caustics") _caustic_photons = std::stoll(value);
+    else if (key == "causticradius") _caustic_radius = std::stof(value);
+    else if (key == "cache") _radiance_cache = std::stoi(value);
+    else if (key == "lightsamples") _light_samples = std::stoi(value);
+    else if (key == "restir") _restir = std::stoi(value);
+    else if (key == "restirspatial") _restir_spatial = std::stoi(value);
+    else if (key == "rr") _roulette = value;
+    else if (key == "splitmax") _split_max = std::stoi(value);
+    else if (key == "denoise") _denoise = std::stoi(value) != 0;
+    else if (key == "bench") _bench = value;
+    else if (key == "generate") _generate = value;
+    else if (key == "gencount") _gen_count = std::stoll(value);
+    else if (key == "genlights") _gen_lights = std::stoi(value);
+    else if (key == "seed") _seed = unsigned(std::stoul(value));
+    else if (key == "workers") _workers = std::stoi(value);
+    else if (key == "worker") _worker_id = std::stoi(value);
+    else if (key == "merge") { _merge_only = true; _workers = std::stoi(value); }
+    else if (key == "partdir") {
+        // the part files are named by appending to it
+        _part_dir = value;
+        if (!_part_dir.empty() && _part_dir.back() != '/' && _part_dir.back() != '\\')
+            _part_dir += '/';
+    }
+    else return false;
+    return true;
+}
+
+void RenderSettings::parseArgs(int argc, char** argv)
+{
+    if (argc < 6) {
+        ERRORM("Usage: %s <scene folder> <scene name> <obj name> <spp> <max depth> [--key value]...\n", argv[0]);
+    }
+    _scene_dir = argv[1];
+    _scene_name = argv[2];
+    _obj_name = argv[3];
+    _spp = std::stoi(argv[4]);
+    _max_depth = std::stoi(argv[5]);
+
+    for (int i = 6; i < argc; i += 2) {
+        std::string key = argv[i];
+        if (key.compare(0, 2, "--") != 0 || i + 1 >= argc) {
+            ERRORM("Expect \"--key value\" pairs after the positional arguments, got %s\n", argv[i]);
+        }
+        if (!set(key.substr(2), argv[i + 1])) {
+            ERRORM("Unknown option %s\n", argv[i]);
+        }
+        _options.emplace_back(key.substr(2), argv[i + 1]);
+    }
+
+    if (_restir_spatial > 0 && _restir <= 0)
+        _restir = 32;
+    if ((_sort_rays || _restir_spatial > 0) && _tile_size <= 0)
+        _tile_size = 64;
+    if (_integrator != "path" && _integrator != "bdpt" && _integrator != "mlt") {
+        ERRORM("Unknown integrator %s\n", _integrator.c_str());
+    }
+    if ((_integrator != "path" || _bench == "bdpt") && _tile_size > 0) {
+        ERRORM("The %s integrator does not run on wavefront tiles\n", _bench == "bdpt" ? "bdpt" : _integrator.c_str());
+    }
+    if (_roulette != "classic" && _roulette != "adaptive") {
+        ERRORM("Unknown roulette %s\n", _roulette.c_str());
+    }
+    if (!_bench.empty() && _bench != "sort" && _bench != "bdpt") {
+        ERRORM("Unknown benchmark %s\n", _bench.c_str());
+    }
+    if (!_generate.empty() && _generate != "random" && _generate != "spheres" && _generate != "cornell" && _generate != "thin") {
+        ERRORM("Unknown scene kind %s\n", _generate.c_str());
+    }
+    if (_workers < 1) {
+        ERRORM("The number of workers must be positive\n");
+    }
+    if (_worker_id >= _workers) {
+        ERRORM("Worker id %d exceeds the worker count %d\n", _worker_id, _workers);
+    }
+    // the feature buffers are only rendered in a single process
+    if (_denoise && (_workers > 1 || _merge_only)) {
+        ERRORM("--denoise does not run with distributed rendering\n");
+    }
+}
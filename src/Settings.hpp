@@ -0,0 +1,56 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+
+// Render options, filled from the command line:
+// PlusProtoEngine <scene folder> <scene name> <obj name> <spp> <max depth> [--key value]...
+class RenderSettings
+{
+public:
+	std::string _scene_dir;
+	std::string _scene_name;
+	std::string _obj_name;
+	int _spp = 4096;
+	int _max_depth = 6;
+	int _threads = 8;
+	std::string _output = "test.jpg";
+	unsigned int _seed = std::mt19937::default_seed;
+	flt _rebuild_ratio = 1.5f;	// animation: rebuild the BVH once refitting made its SAH cost this much worse
+	int _texture_budget = 0;	// MB of decoded textures kept between passes, 0 = unlimited
+	std::string _bvh = "midpoint";	// BVH builder: midpoint, sbvh (spatial splits) or lbvh (Morton codes)
+	flt _split_growth = 0.5f;	// sbvh: at most this fraction of extra references
+	std::string _integrator = "path";	// path, bdpt (bidirectional) or mlt (Metropolis)
+	int _mlt_chains = 1000;	// mlt: independent Markov chains
+	int _tile_size = 0;	// >0 trace tiles of this size as wavefronts instead of one path per pixel
+	bool _sort_rays = false;	// wavefront: sort the paths before traversal and before shading
+	bool _guide = false;	// learn the indirect radiance and sample diffuse bounces from it
+	long long _caustic_photons = 0;	// >0 add a caustic photon map traced with this many photons
+	flt _caustic_radius = 0;	// photon gather radius, 0 = derived from the scene size
+	int _radiance_cache = 0;	// >0 paths end in a radiance cache after this many diffuse bounces
+	int _light_samples = 1;	// light points per hit, their shadow rays are traced as one batch
+	int _restir = 0;	// >0 resample the direct light from this many light points per hit
+	int _restir_spatial = 0;	// wavefront: also reuse the reservoirs of this many neighboring first hits
+	std::string _roulette = "classic";	// classic or adaptive (weight windows with splitting)
+	int _split_max = 4;	// adaptive roulette: most paths one vertex splits into
+	bool _denoise = false;	// filter the final image with the albedo, normal and depth of the first hits
+	std::string _bench;	// "sort" or "bdpt": time the integrators instead of rendering
+	std::string _generate;	// random, spheres, cornell or thin: write a synthetic scene before loading it
+	long long _gen_count = 100000;	// triangles of the generated scene
+	int _gen_lights = 1;	// cornell: number of light quads
+
+	// distributed rendering: the samples are split into _workers disjoint ranges
+	int _workers = 1;
+	int _worker_id = -1;	// >=0 render one range and write it as a part file
+	bool _merge_only = false;	// only merge the part files found in _part_dir
+	std::string _part_dir = "./output/";
+	std::vector<std::pair<std::string, std::string>> _options;	// "--key value" pairs as given, forwarded to spawned workers
+
+public:
+	bool set(const std::string& key, const std::string& value);
+	void parseArgs(int argc, char** argv);
+
+	inline bool isWorker() const { return _worker_id >= 0; }
+	inline int sampleBegin(int worker) const { return int(1LL * _spp * worker / _workers); }
+	inline int sampleEnd(int worker) const { return int(1LL * _spp * (worker + 1) / _workers); }
+};
@@ -0,0 +1,84 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "Stats.hpp"
+#include <mutex>
+#include <algorithm>
+
+static std::mutex s_stats_mutex;
+static std::vector<RenderStats*> s_thread_stats;
+
+RenderStats::RenderStats()
+{
+	std::fill(_counters, _counters + STAT_COUNT, 0LL);
+	_thread = omp_get_thread_num();
+	_busy_seconds = 0;
+	std::lock_guard<std::mutex> lock(s_stats_mutex);
+	s_thread_stats.push_back(this);
+}
+
+RenderStats::~RenderStats()
+{
+	std::lock_guard<std::mutex> lock(s_stats_mutex);
+	s_thread_stats.erase(std::find(s_thread_stats.begin(), s_thread_stats.end(), this));
+}
+
+void RenderStats::reset()
+{
+#ifdef ENABLE_STATS
+	std::lock_guard<std::mutex> lock(s_stats_mutex);
+	for (RenderStats* stats : s_thread_stats) {
+		std::fill(stats->_counters, stats->_counters + STAT_COUNT, 0LL);
+		stats->_busy_seconds = 0;
+	}
+#endif
+}
+
+long long RenderStats::total(StatCounter counter)
+{
+	long long sum = 0;
+#ifdef ENABLE_STATS
+	std::lock_guard<std::mutex> lock(s_stats_mutex);
+	for (RenderStats* stats : s_thread_stats)
+		sum += stats->_counters[counter];
+#else
+	(void)counter;
+#endif
+	return sum;
+}
+
+void RenderStats::report(double seconds)
+{
+#ifdef ENABLE_STATS
+	std::lock_guard<std::mutex> lock(s_stats_mutex);
+	long long c[STAT_COUNT] = { 0 };
+	for (RenderStats* stats : s_thread_stats)
+		for (int i = 0; i < STAT_COUNT; i++)
+			c[i] += stats->_counters[i];
+
+	long long rays = c[STAT_CAMERA_RAYS] + c[STAT_BOUNCE_RAYS] + c[STAT_SHADOW_RAYS];
+	long long hits = c[STAT_HIT_LIGHT] + c[STAT_HIT_DIFFUSE] + c[STAT_HIT_GLASS];
+	double per_ray = rays > 0 ? 1.0 / rays : 0;
+	seconds = glm::max(seconds, 1e-9);
+
+	INFO("Render statistics, %.2f s:\n", seconds);
+	INFO("  rays: %lld camera, %lld bounce, %lld shadow, %.3f Mrays/s\n",
+		c[STAT_CAMERA_RAYS], c[STAT_BOUNCE_RAYS], c[STAT_SHADOW_RAYS], rays / seconds * 1e-6);
+	INFO("  BVH nodes visited: %lld (%.1f per ray), triangle tests: %lld (%.1f per ray)\n",
+		c[STAT_BVH_NODES], c[STAT_BVH_NODES] * per_ray, c[STAT_TRIANGLE_TESTS], c[STAT_TRIANGLE_TESTS] * per_ray);
+	INFO("  hits: %lld light, %lld diffuse, %lld glass, average path length %.2f\n",
+		c[STAT_HIT_LIGHT], c[STAT_HIT_DIFFUSE], c[STAT_HIT_GLASS],
+		c[STAT_CAMERA_RAYS] > 0 ? double(hits) / c[STAT_CAMERA_RAYS] : 0.0);
+	INFO("  russian roulette terminations: %lld, non-finite samples dropped: %lld\n",
+		c[STAT_RR_TERMINATED], c[STAT_NONFINITE]);
+	// over the time each thread spent rendering, not the wall time of the render
+	for (const RenderStats* stats : s_thread_stats) {
+		const long long* tc = stats->_counters;
+		long long thread_rays = tc[STAT_CAMERA_RAYS] + tc[STAT_BOUNCE_RAYS] + tc[STAT_SHADOW_RAYS];
+		if (thread_rays > 0 && stats->_busy_seconds > 0)
+			INFO("  thread %d: %lld rays in %.2f s, %.3f Mrays/s\n", stats->_thread, thread_rays,
+				stats->_busy_seconds, thread_rays / stats->_busy_seconds * 1e-6);
+	}
+#else
+	(void)seconds;
+#endif
+}
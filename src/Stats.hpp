@@ -0,0 +1,73 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+
+enum StatCounter {
+	STAT_CAMERA_RAYS,
+	STAT_BOUNCE_RAYS,
+	STAT_SHADOW_RAYS,
+	STAT_BVH_NODES,
+	STAT_TRIANGLE_TESTS,
+	STAT_HIT_LIGHT,	// hits per MatType, in its order
+	STAT_HIT_DIFFUSE,
+	STAT_HIT_GLASS,
+	STAT_RR_TERMINATED,
+	STAT_NONFINITE,
+	STAT_CAUSTIC_GATHERS,
+	STAT_RADIANCE_CACHE_LOOKUPS,	// lookups, hits and dropped splats of a RadianceCache, in this order
+	STAT_RADIANCE_CACHE_HITS,
+	STAT_RADIANCE_CACHE_DROPPED,
+	STAT_ROULETTE_CACHE_LOOKUPS,
+	STAT_ROULETTE_CACHE_HITS,
+	STAT_ROULETTE_CACHE_DROPPED,
+	STAT_COUNT
+};
+
+// Render counters, one set per thread so the hot paths never share a cache
+// line. Only built with -DPLUSPROTO_STATS=ON, otherwise STAT_ADD compiles to
+// nothing and reset()/report() do nothing.
+class RenderStats
+{
+public:
+	long long _counters[STAT_COUNT];
+	int _thread;	// OpenMP thread number of the thread that created it
+	double _busy_seconds;	// time spent inside STAT_BUSY_SCOPE, the denominator of its ray rate
+
+	RenderStats();
+	~RenderStats();
+
+	static inline RenderStats& local()
+	{
+		static thread_local RenderStats stats;
+		return stats;
+	}
+	static void reset();
+	static void report(double seconds);
+	// sum over the threads, 0 without PLUSPROTO_STATS
+	static long long total(StatCounter counter);
+};
+
+#ifdef ENABLE_STATS
+#define STAT_ADD(counter, n) (RenderStats::local()._counters[counter] += (n))
+#else
+#define STAT_ADD(counter, n) ((void)0)
+#endif
+#define STAT_INC(counter) STAT_ADD(counter, 1)
+
+// Adds the lifetime of the scope to the calling thread's _busy_seconds.
+class BusyTimer
+{
+public:
+	double _start;
+
+	BusyTimer() : _start(omp_get_wtime()) {}
+	~BusyTimer() { RenderStats::local()._busy_seconds += omp_get_wtime() - _start; }
+};
+
+// At the top of a parallel region, around the work a thread renders.
+#ifdef ENABLE_STATS
+#define STAT_BUSY_SCOPE() BusyTimer busy_timer_
+#else
+#define STAT_BUSY_SCOPE() ((void)0)
+#endif
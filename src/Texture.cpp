@@ -0,0 +1,153 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include <cstring>
+#include "Texture.hpp"
+#include "TextureCache.hpp"
+
+// Same curve stbi_loadf applies to LDR images, so 8-bit textures look as before.
+const flt* MipLevel::srgbTable()
+{
+    static const std::vector<flt> table = []() {
+        std::vector<flt> t(256);
+        for (int i = 0; i < 256; i++)
+            t[i] = powf(i / 255.0f, 2.2f);
+        return t;
+    }();
+    return table.data();
+}
+
+void MipLevel::init(int w, int h, TexelFormat format)
+{
+    _width = w;
+    _height = h;
+    _format = format;
+    _tiles_x = (w + kTileSize - 1) >> kTileBits;
+    int tiles_y = (h + kTileSize - 1) >> kTileBits;
+    _data.assign(size_t(_tiles_x) * tiles_y * kTileSize * kTileSize * texelBytes(), 0);
+}
+
+void MipLevel::set(int x, int y, const glm::vec3& color)
+{
+    uchar* texel = &_data[offset(x, y)];
+    if (_format == TEXEL_SRGB8) {
+        for (int c = 0; c < picChannel; c++)
+            texel[c] = static_cast<uchar>(glm::clamp(powf(glm::max(color[c], flt(0)), 1 / 2.2f), flt(0), flt(1)) * 255 + flt(0.5));
+    }
+    else {
+        uint16_t* half = reinterpret_cast<uint16_t*>(texel);
+        for (int c = 0; c < picChannel; c++)
+            half[c] = glm::packHalf1x16(color[c]);
+    }
+}
+
+glm::vec3 MipLevel::bilinear(const glm::vec2& uv) const
+{
+    // texel centers sit at half integers
+    flt x = uv[0] * _width - flt(0.5);
+    flt y = (1.0f - uv[1]) * _height - flt(0.5);
+    int x0 = static_cast<int>(floorf(x));
+    int y0 = static_cast<int>(floorf(y));
+    flt fx = x - x0, fy = y - y0;
+
+    glm::vec3 top = glm::mix(at(x0, y0), at(x0 + 1, y0), fx);
+    glm::vec3 bottom = glm::mix(at(x0, y0 + 1), at(x0 + 1, y0 + 1), fx);
+    return glm::mix(top, bottom, fy);
+}
+
+// 8-bit texels are copied as they are, no decode/encode round trip.
+void Texture::init(int w, int h, const uchar* data)
+{
+    _levels.clear();
+    _levels.resize(1);
+    MipLevel& level = _levels[0];
+    level.init(w, h, TEXEL_SRGB8);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            memcpy(&level._data[level.offset(x, y)], data + picChannel * (size_t(y) * w + x), picChannel);
+    _lod_bias = flt(0.5) * log2f(flt(w) * flt(h));
+}
+
+void Texture::init(int w, int h, const flt* data)
+{
+    _levels.clear();
+    _levels.resize(1);
+    MipLevel& level = _levels[0];
+    level.init(w, h, TEXEL_HALF);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) {
+            const flt* texel = data + picChannel * (size_t(y) * w + x);
+            level.set(x, y, glm::vec3(texel[0], texel[1], texel[2]));
+        }
+    _lod_bias = flt(0.5) * log2f(flt(w) * flt(h));
+}
+
+// 2x2 box filter down to 1x1, odd sizes fold the last row/column into the previous texel.
+// Filtering happens on decoded values, every level keeps the format of level 0.
+void Texture::buildMipmaps()
+{
+    _levels.resize(1);
+    while (_levels.back()._width > 1 || _levels.back()._height > 1) {
+        const MipLevel& src = _levels.back();
+        int w = std::max(1, src._width / 2);
+        int h = std::max(1, src._height / 2);
+        std::vector<glm::vec3> sum(size_t(w) * h, glm::vec3(0));
+
+        for (int y = 0; y < src._height; y++) {
+            int dy = std::min(y / 2, h - 1);
+            for (int x = 0; x < src._width; x++) {
+                int dx = std::min(x / 2, w - 1);
+                sum[dy * w + dx] += src.at(x, y);
+            }
+        }
+
+        MipLevel dst;
+        dst.init(w, h, src._format);
+        for (int y = 0; y < h; y++) {
+            int ny = (y == h - 1) ? src._height - 2 * y : 2;
+            for (int x = 0; x < w; x++) {
+                int nx = (x == w - 1) ? src._width - 2 * x : 2;
+                dst.set(x, y, sum[y * w + x] / flt(nx * ny));
+            }
+        }
+        _levels.push_back(std::move(dst));
+    }
+}
+
+void Texture::load()
+{
+    std::lock_guard<std::mutex> lock(_load_mutex);
+    if (!_resident.load(std::memory_order_relaxed)) {
+        _cache->decode(*this);
+        _resident.store(true, std::memory_order_release);
+    }
+}
+
+glm::vec3 Texture::sample(const glm::vec2& uv, flt uv_lod)
+{
+    if (_cache) {
+        if (!isResident())
+            load();
+        int pass = _cache->getPass();
+        if (_last_used.load(std::memory_order_relaxed) != pass)
+            _last_used.store(pass, std::memory_order_relaxed);
+    }
+
+    flt lod = uv_lod + _lod_bias;
+    int last = getLevelCount() - 1;
+    if (!(lod > 0) || last == 0)
+        return _levels[0].bilinear(uv);
+    if (lod >= last)
+        return _levels[last].bilinear(uv);
+
+    int l0 = static_cast<int>(lod);
+    flt f = lod - l0;
+    return glm::mix(_levels[l0].bilinear(uv), _levels[l0 + 1].bilinear(uv), f);
+}
+
+size_t Texture::bytes() const
+{
+    size_t total = 0;
+    for (const auto& level : _levels)
+        total += level.bytes();
+    return total;
+}
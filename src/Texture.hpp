@@ -0,0 +1,104 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include <atomic>
+#include <mutex>
+#include "Global.hpp"
+#include <glm/gtc/packing.hpp>
+
+class TextureCache;
+
+enum TexelFormat {
+    TEXEL_SRGB8 = 0,    // 8-bit gamma encoded, decoded through a lookup table
+    TEXEL_HALF = 1      // 16-bit float for HDR images
+};
+
+// One mip level. Texels are stored in 8x8 tiles with Morton order inside a tile,
+// so the 2x2 footprint of a bilinear lookup usually stays in one or two cache lines.
+class MipLevel {
+public:
+    static const int kTileBits = 3;
+    static const int kTileSize = 1 << kTileBits;
+
+    int _width = 0, _height = 0;
+    int _tiles_x = 0;
+    TexelFormat _format = TEXEL_SRGB8;
+    std::vector<uchar> _data;
+
+    void init(int w, int h, TexelFormat format);
+    void set(int x, int y, const glm::vec3& color);
+    glm::vec3 bilinear(const glm::vec2& uv) const;
+
+    inline size_t texelBytes() const { return _format == TEXEL_HALF ? picChannel * sizeof(uint16_t) : picChannel; }
+    inline size_t bytes() const { return _data.size(); }
+
+    inline size_t offset(int x, int y) const {
+        int tile = (y >> kTileBits) * _tiles_x + (x >> kTileBits);
+        return (size_t(tile) * kTileSize * kTileSize + morton(x & (kTileSize - 1), y & (kTileSize - 1))) * texelBytes();
+    }
+    inline glm::vec3 at(int x, int y) const {
+        x = (x % _width + _width) % _width;
+        y = (y % _height + _height) % _height;
+        const uchar* texel = &_data[offset(x, y)];
+        if (_format == TEXEL_SRGB8) {
+            const flt* lut = srgbTable();
+            return glm::vec3(lut[texel[0]], lut[texel[1]], lut[texel[2]]);
+        }
+        const uint16_t* half = reinterpret_cast<const uint16_t*>(texel);
+        return glm::vec3(glm::unpackHalf1x16(half[0]), glm::unpackHalf1x16(half[1]), glm::unpackHalf1x16(half[2]));
+    }
+
+    // interleave the 3 low bits of x and y
+    static inline int morton(int x, int y) {
+        x = (x | (x << 2)) & 0x33; x = (x | (x << 1)) & 0x55;
+        y = (y | (y << 2)) & 0x33; y = (y | (y << 1)) & 0x55;
+        return x | (y << 1);
+    }
+    static const flt* srgbTable();
+};
+
+// Texture with a mip pyramid, level 0 is the full resolution image.
+// Textures owned by a TextureCache are decoded on first lookup and may be
+// evicted again between sample passes.
+class Texture {
+private:
+    std::vector<MipLevel> _levels;
+    flt _lod_bias = 0; // 0.5 * log2(texel count of level 0)
+
+    std::string _path;
+    TextureCache* _cache = nullptr;
+    std::atomic<bool> _resident{ false };
+    std::atomic<int> _last_used{ -1 };
+    std::mutex _load_mutex;
+
+    void load();
+    friend class TextureCache;
+
+public:
+    Texture() {};
+    Texture(const std::string& path, TextureCache* cache) : _path(path), _cache(cache) {}
+    void init(int w, int h, const uchar* data);
+    void init(int w, int h, const flt* data);
+    void buildMipmaps();
+
+    inline glm::vec3 at(int x, int y) const {
+        return _levels[0].at(x, y);
+    }
+    inline glm::vec3 at(flt x, flt y) const {
+        return this->at(static_cast<int>(round(x)), static_cast<int>(round(y)));
+    }
+    inline glm::vec3 at(const glm::vec2& uv) const {
+        return this->at((getWidth())*uv[0], (getHeight()) * (1.0f - uv[1]));
+    }
+    // Trilinear lookup, uv_lod is log2 of the ray footprint in uv units (see HitRecord::_lod).
+    glm::vec3 sample(const glm::vec2& uv, flt uv_lod);
+
+    size_t bytes() const;
+    inline int getWidth() const { return _levels[0]._width; }
+    inline int getHeight() const { return _levels[0]._height; }
+    inline int getLevelCount() const { return int(_levels.size()); }
+    inline TexelFormat getFormat() const { return _levels[0]._format; }
+    inline const MipLevel& getLevel(int l) const { return _levels[l]; }
+    inline const std::string& getPath() const { return _path; }
+    inline bool isResident() const { return _resident.load(std::memory_order_acquire); }
+};
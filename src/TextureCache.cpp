@@ -0,0 +1,89 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include <algorithm>
+#include "TextureCache.hpp"
+
+shared_ptr<Texture> TextureCache::get(const std::string& path)
+{
+    auto it = _textures.find(path);
+    if (it != _textures.end())
+        return it->second;
+
+    // only the header is read here, so a missing or unusable file still fails at scene load
+    int w, h, channel;
+    if (!stbi_info(path.c_str(), &w, &h, &channel)) {
+        ERRORM("Cannot load texture %s\n", path.c_str());
+    }
+    if (channel != 3) {
+        ERRORM("The channel of input texture %s is not equal to 3\n", path.c_str());
+    }
+    shared_ptr<Texture> texture = make_shared<Texture>(path, this);
+    _textures.insert(std::make_pair(path, texture));
+    return texture;
+}
+
+// Called with the texture's load mutex held.
+void TextureCache::decode(Texture& texture)
+{
+    const char* path = texture._path.c_str();
+    int load_channel;
+    int texture_width, texture_height;
+    // HDR images keep half floats, LDR images keep their 8-bit texels
+    bool is_hdr = stbi_is_hdr(path);
+    void* texture_data = is_hdr ?
+        static_cast<void*>(stbi_loadf(path, &texture_width, &texture_height, &load_channel, picChannel)) :
+        static_cast<void*>(stbi_load(path, &texture_width, &texture_height, &load_channel, picChannel));
+    if (!texture_data) {
+        ERRORM("Cannot load texture %s\n", path);
+    }
+
+    if (is_hdr)
+        texture.init(texture_width, texture_height, static_cast<flt*>(texture_data));
+    else
+        texture.init(texture_width, texture_height, static_cast<uchar*>(texture_data));
+    stbi_image_free(texture_data);
+    texture.buildMipmaps();
+
+    _bytes += texture.bytes();
+    _loads++;
+    DEBUGM("Texture %s: %d x %d, %d mip levels, %zu bytes\n", path,
+        texture_width, texture_height, texture.getLevelCount(), texture.bytes());
+}
+
+void TextureCache::evict(Texture& texture)
+{
+    _bytes -= texture.bytes();
+    std::vector<MipLevel>().swap(texture._levels);
+    texture._resident.store(false, std::memory_order_release);
+    _evictions++;
+}
+
+// No lookups run between passes, so textures can be released safely here.
+void TextureCache::endPass()
+{
+    _peak_bytes = std::max(_peak_bytes, _bytes.load());
+    _pass++;
+    if (_budget == 0 || _bytes.load() <= _budget)
+        return;
+
+    std::vector<Texture*> resident;
+    for (auto& item : _textures) {
+        if (item.second->isResident())
+            resident.push_back(item.second.get());
+    }
+    std::sort(resident.begin(), resident.end(), [](const Texture* a, const Texture* b) {
+        return a->_last_used.load() < b->_last_used.load();
+    });
+    for (Texture* texture : resident) {
+        if (_bytes.load() <= _budget)
+            break;
+        evict(*texture);
+    }
+}
+
+void TextureCache::printStats() const
+{
+    INFO("Texture Cache: %d files, %d loads, %d evictions, %.2f MB resident, %.2f MB peak\n",
+        getTextureCount(), _loads.load(), _evictions,
+        _bytes.load() / 1048576.0, std::max(_peak_bytes, _bytes.load()) / 1048576.0);
+}
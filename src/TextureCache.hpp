@@ -0,0 +1,32 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Texture.hpp"
+
+// Path keyed texture store shared by all materials. Files are decoded on the
+// first lookup that needs them (thread safe), and when a memory budget is set
+// the least recently used textures are dropped again at the end of a pass.
+class TextureCache
+{
+private:
+	std::map<std::string, shared_ptr<Texture>> _textures;
+	size_t _budget = 0;	// bytes, 0 means unlimited
+	std::atomic<size_t> _bytes{ 0 };
+	std::atomic<int> _loads{ 0 };
+	size_t _peak_bytes = 0;
+	int _evictions = 0;
+	int _pass = 0;
+
+public:
+	shared_ptr<Texture> get(const std::string& path);
+	void decode(Texture& texture);
+	void evict(Texture& texture);
+	void endPass();
+	void printStats() const;
+
+	inline void setBudget(size_t bytes) { _budget = bytes; }
+	inline int getPass() const { return _pass; }
+	inline size_t getBytes() const { return _bytes.load(); }
+	inline int getTextureCount() const { return int(_textures.size()); }
+};
@@ -0,0 +1,267 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#include "Wavefront.hpp"
+#include "Scene.hpp"
+#include "ReSTIR.hpp"
+#include <algorithm>
+
+namespace {
+
+const int kReuseRadius = 5;	// pixels
+const flt kReuseNormalCos = 0.9f;	// neighbors whose normal differs more are skipped
+
+}
+
+void WavefrontRender::finish(Scene& scene, const PathState& path)
+{
+    const glm::vec3& color = path._color;
+    if (std::isfinite(color[0]) && std::isfinite(color[1]) && std::isfinite(color[2]))
+        scene.buf.addColor(path._x, path._y, color);
+    else
+        STAT_INC(STAT_NONFINITE);
+}
+
+void WavefrontRender::sortByKey(std::vector<PathState>& paths, std::vector<PathState>& sorted)
+{
+    std::vector<std::pair<unsigned long long, int>> order(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        order[i] = std::make_pair(paths[i]._key, int(i));
+    std::sort(order.begin(), order.end());
+
+    sorted.resize(paths.size());
+    for (size_t i = 0; i < order.size(); i++)
+        sorted[i] = paths[order[i].second];
+    paths.swap(sorted);
+}
+
+// The diffuse first hits draw their own light candidates, then each combines
+// its reservoir with those of a few random neighbors of the tile within
+// kReuseRadius pixels. combined[i] belongs to paths[i].
+void WavefrontRender::reuseReservoirs(Scene& scene, int x0, int y0, int x1, int y1,
+    std::vector<PathState>& paths, std::vector<LightReservoir>& combined)
+{
+    int w = x1 - x0, h = y1 - y0;
+    std::vector<int> at(size_t(w) * h, -1);
+    std::vector<LightReservoir> own(paths.size());
+    std::vector<glm::vec3> wo(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        PathState& path = paths[i];
+        HitRecord& rec = path._rec;
+        if (rec._mat->_type == MatType::LIGHT || rec._mat->_type == MatType::GLASS)
+            continue;
+        wo[i] = -path._ray.getDirection();
+        rec._normal = glm::dot(rec._normal, wo[i]) > 0 ? rec._normal : -rec._normal;
+        ResampledLights::sample(scene.egroup, rec, wo[i], scene.settings._restir, own[i]);
+        at[size_t(path._y - y0) * w + (path._x - x0)] = int(i);
+    }
+
+    combined.assign(paths.size(), LightReservoir());
+    std::vector<ReservoirSite> sites;
+    for (size_t i = 0; i < paths.size(); i++) {
+        const PathState& path = paths[i];
+        if (at[size_t(path._y - y0) * w + (path._x - x0)] != int(i))
+            continue;
+        sites.clear();
+        sites.push_back(ReservoirSite{ &paths[i]._rec, wo[i], &own[i] });
+        for (int k = 0; k < scene.settings._restir_spatial; k++) {
+            int nx = path._x + int(floorf(random_range(-kReuseRadius, kReuseRadius + 1)));
+            int ny = path._y + int(floorf(random_range(-kReuseRadius, kReuseRadius + 1)));
+            if (nx < x0 || nx >= x1 || ny < y0 || ny >= y1)
+                continue;
+            int j = at[size_t(ny - y0) * w + (nx - x0)];
+            if (j < 0 || j == int(i) || glm::dot(paths[j]._rec._normal, path._rec._normal) < kReuseNormalCos)
+                continue;
+            sites.push_back(ReservoirSite{ &paths[j]._rec, wo[j], &own[j] });
+        }
+        ResampledLights::combine(sites.data(), int(sites.size()), combined[i]);
+    }
+}
+
+// Same integrator as Scene::Li, reorganized into a traversal and a shading
+// stage per bounce. Returns the number of extension rays traced.
+long long WavefrontRender::renderTile(Scene& scene, int x0, int y0, int x1, int y1, int maxdepth,
+    std::vector<PathState>& paths, std::vector<PathState>& sorted)
+{
+    bool sort_rays = scene.settings._sort_rays;
+    const AABB& bounds = scene.bvh_tree.getBounds();
+    glm::vec3 lo = bounds.getMin();
+    glm::vec3 extent = glm::max(bounds.getMax() - lo, glm::vec3(1e-20f));
+    size_t num_materials = scene.materials.size();
+    long long rays = 0;
+    std::vector<LightReservoir> combined;
+
+    paths.clear();
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            PathState path;
+            path._ray = scene.cam.genRayRandom(x, y);
+            path._throughput = glm::vec3(1.0f);
+            path._color = glm::vec3(0.0f);
+            path._x = x;
+            path._y = y;
+            path._look_light = true;
+            paths.push_back(path);
+        }
+    }
+
+    ShadingBatch batch;
+    for (int bounce = 0; bounce < maxdepth && !paths.empty(); bounce++) {
+        // traversal, sorted by direction octant and then origin along a Morton curve
+        if (sort_rays) {
+            for (PathState& path : paths) {
+                glm::vec3 dir = path._ray.getDirection();
+                unsigned long long octant = (dir.x < 0) | (dir.y < 0) << 1 | (dir.z < 0) << 2;
+                path._key = octant << 61 | mortonCode((path._ray.getOrigin() - lo) / extent) >> 2;
+            }
+            sortByKey(paths, sorted);
+        }
+        size_t alive = 0;
+        for (PathState& path : paths) {
+            rays++;
+            STAT_INC(bounce == 0 ? STAT_CAMERA_RAYS : STAT_BOUNCE_RAYS);
+            if (!scene.bvh_tree.hit(path._ray, kHitEps, INFINITY, path._rec)) {
+                if (path._look_light && scene.environment.enabled())
+                    path._color += path._throughput * scene.environment.Le(path._ray.getDirection());
+                finish(scene, path);
+                continue;
+            }
+            path._cone_width = path._ray.coneWidthAt(path._rec._t);
+            if (!path._rec._mat)
+                path._rec._mat = &scene.default_mat;
+            STAT_INC(STAT_HIT_LIGHT + path._rec._mat->_type);
+            paths[alive++] = path;
+        }
+        paths.resize(alive);
+
+        // shading, sorted by material
+        if (sort_rays) {
+            for (PathState& path : paths) {
+                const Material* mat = path._rec._mat;
+                path._key = mat == &scene.default_mat ? num_materials : size_t(mat - scene.materials.data());
+            }
+            sortByKey(paths, sorted);
+        }
+        bool reuse = bounce == 0 && scene.settings._restir_spatial > 0;
+        if (reuse)
+            reuseReservoirs(scene, x0, y0, x1, y1, paths, combined);
+        alive = 0;
+        for (size_t begin = 0; begin < paths.size(); begin += ShadingBatch::kSize) {
+            size_t end = std::min(paths.size(), begin + ShadingBatch::kSize);
+            batch.clear();
+            for (size_t i = begin; i < end; i++) {
+                PathState& path = paths[i];
+                HitRecord& rec = path._rec;
+                const Material* mat = rec._mat;
+                glm::vec3 dir = path._ray.getDirection();
+                path._lane = -1;
+
+                if (mat->_type == MatType::LIGHT) {
+                    if (glm::dot(rec._normal, dir) < 0 && path._look_light)
+                        path._color += path._throughput * mat->_ke;
+                    continue;
+                }
+
+                glm::vec3 wo = -dir;
+                if (mat->_type == MatType::GLASS) {
+                    path._pdf = mat->scatter(path._ray, rec, path._next);
+                    path._lane = batch.add(path._next.getDirection(), rec, wo);
+                    continue;
+                }
+
+                path._look_light = false;
+                rec._normal = glm::dot(rec._normal, wo) > 0 ? rec._normal : -rec._normal;
+                path._color += path._throughput * (reuse ? ResampledLights::shade(scene.bvh_tree, rec, wo, combined[i])
+                                                         : scene.sampleLight(path._ray, rec));
+
+                path._pdf = mat->scatter(path._ray, rec, path._next);
+                glm::vec3 wi = path._next.getDirection();
+                if (glm::dot(wi, rec._normal) > 0 && path._pdf > kEps)
+                    path._lane = batch.add(wi, rec, wo);
+            }
+            batch.eval();
+
+            for (size_t i = begin; i < end; i++) {
+                PathState& path = paths[i];
+                if (path._lane < 0) {
+                    finish(scene, path);
+                    continue;
+                }
+                bool glass = path._rec._mat->_type == MatType::GLASS;
+                if (glass)
+                    path._throughput *= batch.bsdf(path._lane);
+                else {
+                    flt cos = fabs(glm::dot(path._next.getDirection(), path._rec._normal));
+                    path._throughput *= batch.bsdf(path._lane) * cos / path._pdf;
+                }
+                path._next.setCone(path._cone_width, path._ray.getConeSpread());
+                path._ray = path._next;
+
+                if (!glass && bounce >= 3) {
+                    flt ran = random_float();
+                    if (ran < glm::compMax(path._throughput))
+                        path._throughput /= glm::compMax(path._throughput);
+                    else {
+                        STAT_INC(STAT_RR_TERMINATED);
+                        finish(scene, path);
+                        continue;
+                    }
+                }
+                paths[alive++] = path;
+            }
+        }
+        paths.resize(alive);
+    }
+    for (const PathState& path : paths)
+        finish(scene, path);
+    return rays;
+}
+
+void WavefrontRender::renderSample(Scene& scene, int maxdepth)
+{
+    int tile = scene.settings._tile_size;
+    int tiles_x = (scene.cam.getWidth() + tile - 1) / tile;
+    int tiles_y = (scene.cam.getHeight() + tile - 1) / tile;
+    long long rays = 0;
+
+#pragma omp parallel num_threads(scene.settings._threads) reduction(+:rays)
+    {
+        STAT_BUSY_SCOPE();
+        std::vector<PathState> paths, sorted;
+        paths.reserve(size_t(tile) * tile);
+#pragma omp for schedule(dynamic) nowait
+        for (int t = 0; t < tiles_x * tiles_y; t++) {
+            int x0 = (t % tiles_x) * tile, y0 = (t / tiles_x) * tile;
+            rays += renderTile(scene, x0, y0,
+                std::min(x0 + tile, scene.cam.getWidth()), std::min(y0 + tile, scene.cam.getHeight()),
+                maxdepth, paths, sorted);
+        }
+    }
+    scene.extension_rays += rays;
+}
+
+// Times the same passes with the per pixel integrator and the wavefront one
+// without and with sorting. Only the wavefront paths count their rays.
+void WavefrontRender::benchmark(Scene& scene, int spp, int maxdepth)
+{
+    struct Mode { const char* _name; int _tile; bool _sort; };
+    int tile = scene.settings._tile_size > 0 ? scene.settings._tile_size : 64;
+    Mode modes[] = { { "per pixel", 0, false }, { "wavefront", tile, false }, { "wavefront sorted", tile, true } };
+
+    for (const Mode& mode : modes) {
+        scene.settings._tile_size = mode._tile;
+        scene.settings._sort_rays = mode._sort;
+        scene.extension_rays = 0;
+        scene.buf.clear();
+        random_seed(scene.settings._seed);
+
+        double start = omp_get_wtime();
+        for (int s = 0; s < spp; s++)
+            scene.renderSample(s, maxdepth);
+        double seconds = omp_get_wtime() - start;
+
+        if (mode._tile > 0)
+            INFO("%-17s %8.3f s  %7.3f Mrays/s (extension rays)\n", mode._name, seconds, scene.extension_rays / seconds * 1e-6);
+        else
+            INFO("%-17s %8.3f s\n", mode._name, seconds);
+    }
+}
@@ -0,0 +1,47 @@
+// Author: Peiyao Li
+// Date:   Oct 19 2026
+#pragma once
+#include "Global.hpp"
+#include "Ray.hpp"
+#include "Model.hpp"
+
+class Scene;
+class LightReservoir;
+
+// One camera path in flight, advanced a bounce at a time.
+class PathState
+{
+public:
+	Ray _ray;
+	Ray _next;	// scattered ray, becomes _ray once the bsdf is applied
+	HitRecord _rec;
+	glm::vec3 _throughput;
+	glm::vec3 _color;
+	flt _pdf;
+	flt _cone_width;
+	int _x, _y;
+	int _lane;	// slot in the shading batch, -1 once the path ended
+	bool _look_light;
+	unsigned long long _key;
+};
+
+// Renders a pass tile by tile. The camera paths of a tile form a wave that is
+// traced one bounce at a time: traverse all, then shade all in batches. With
+// sorting on, the wave is reordered by direction octant and origin Morton code
+// before traversal and by material before shading, so neighbouring paths walk
+// the same BVH nodes and use the same material. With spatial ReSTIR the first
+// hits of a tile also share their light reservoirs.
+class WavefrontRender
+{
+public:
+	static void renderSample(Scene& scene, int maxdepth);
+	static void benchmark(Scene& scene, int spp, int maxdepth);
+
+private:
+	static long long renderTile(Scene& scene, int x0, int y0, int x1, int y1, int maxdepth,
+		std::vector<PathState>& paths, std::vector<PathState>& sorted);
+	static void sortByKey(std::vector<PathState>& paths, std::vector<PathState>& sorted);
+	static void reuseReservoirs(Scene& scene, int x0, int y0, int x1, int y1,
+		std::vector<PathState>& paths, std::vector<LightReservoir>& combined);
+	static void finish(Scene& scene, const PathState& path);
+};
@@ -3,39 +3,97 @@
 
 #include "Global.hpp" 
 #include "Scene.hpp"
+#include "Distributed.hpp"
+#include "Wavefront.hpp"
+#include "SceneGen.hpp"
+#include "BDPT.hpp"
+#ifdef _WIN32
 #include <io.h>
 #include <direct.h>
+#define MAKE_DIR(dir) _mkdir(dir)
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#define _access access
+#define MAKE_DIR(dir) mkdir(dir, 0755)
+#endif
 
-int main() {
-    int maxDepth = 6;
-    int numSamplePerPixel = 4096;
-    std::string output = "test.jpg";
-    
-    std::string sceneDir = "./scene/myscene/";
-    std::string sceneName = "myscene";
-    std::string objName = "myscene";
-
-
-    std::cout << "Please input the scene folder..." << std::endl;
-    std::cin >> sceneDir;
-    std::cout << "Please input the scene name..." << std::endl;
-    std::cin >> sceneName;
-    std::cout << "Please input the obj name..." << std::endl;
-    std::cin >> objName;
-    std::cout << "Please input the sample per pixel..." << std::endl;
-    std::cin >> numSamplePerPixel;
-    std::cout << "Please input the max bounce depth..." << std::endl;
-    std::cin >> maxDepth;
+int main(int argc, char** argv) {
+    RenderSettings settings;
+
+    if (argc > 1) {
+        settings.parseArgs(argc, argv);
+    }
+    else {
+        settings._scene_dir = "./scene/myscene/";
+        settings._scene_name = "myscene";
+        settings._obj_name = "myscene";
+
+        std::cout << "Please input the scene folder..." << std::endl;
+        std::cin >> settings._scene_dir;
+        std::cout << "Please input the scene name..." << std::endl;
+        std::cin >> settings._scene_name;
+        std::cout << "Please input the obj name..." << std::endl;
+        std::cin >> settings._obj_name;
+        std::cout << "Please input the sample per pixel..." << std::endl;
+        std::cin >> settings._spp;
+        std::cout << "Please input the max bounce depth..." << std::endl;
+        std::cin >> settings._max_depth;
+    }
 
     //жļǷڣ򴴽
     const char* dir = "./output/";
     if (_access(dir, 0) == -1)
     {
-        _mkdir(dir);
+        MAKE_DIR(dir);
+    }
+    if (_access(settings._part_dir.c_str(), 0) == -1)
+    {
+        MAKE_DIR(settings._part_dir.c_str());
+    }
+
+    // workers load the scene their coordinator generated
+    if (!settings._generate.empty() && !settings.isWorker())
+        SceneGenerator::generate(settings);
+
+    // coordinator of a distributed render, merge the parts of all workers
+    if (settings._merge_only || (settings._workers > 1 && !settings.isWorker())) {
+        if (!settings._merge_only && !DistributedRender::launchWorkers(argv[0], settings)) {
+            ERRORM("Distributed render failed\n");
+        }
+        Buffer merged;
+        int spp = 0;
+        if (!DistributedRender::mergeParts(settings, merged, spp)) {
+            ERRORM("Cannot merge the parts in %s\n", settings._part_dir.c_str());
+        }
+        merged.renderToPic(settings._output, 2.2, spp);
+        return 0;
+    }
+
+    Scene scene;
+    scene.settings = settings;
+    scene.buildScene(settings._scene_dir, settings._scene_name, settings._obj_name);
+
+    if (settings.isWorker()) {
+        random_seed(settings._seed + 104729u * settings._worker_id);
+        DistributedRender::renderPart(scene);
+        return 0;
+    }
+
+    if (settings._bench == "sort") {
+        WavefrontRender::benchmark(scene, settings._spp, settings._max_depth);
+        return 0;
+    }
+    if (settings._bench == "bdpt") {
+        BidirectionalRender::benchmark(scene, settings._spp, settings._max_depth);
+        return 0;
     }
 
-    Scene scene(sceneDir, sceneName, objName);
-    scene.render(output, numSamplePerPixel, maxDepth);
+    random_seed(settings._seed);
+    if (scene.animation.enabled())
+        scene.renderAnimation(settings._spp, settings._max_depth);
+    else
+        scene.render(settings._output, settings._spp, settings._max_depth);
 
     // read xml & obj & mtl firstly, then add other objects
     //shared_ptr<Material> mat = std::make_shared<PhongMaterial>();